@@ -1,16 +1,18 @@
 #include "ast.h"
+#include "profiler.h"
+#include "budget.h"
 
 // Global root node pointer
 ASTNode* root = nullptr;
 
 // Default constructor for ASTNode
-ASTNode::ASTNode() : node_type(STRING_H), data(""), attributes("") {
+ASTNode::ASTNode() : node_type(STRING_H), data(""), attributes(""), span{nullptr, 0} {
     // Initializes node with default values
 }
 
 // Parameterized constructor for ASTNode
 ASTNode::ASTNode(NodeType type, const string &data, const string &attributes) 
-    : node_type(type), data(data), attributes(attributes) {
+    : node_type(type), data(data), attributes(attributes), span{nullptr, 0} {
     // Initializes node with specified type, data, and attributes
 }
 
@@ -53,8 +55,10 @@ ASTManager::~ASTManager() {
     // Destructor for cleanup (no dynamic memory to handle directly here)
 }
 
-// Creates a new AST node of the specified type
+// Creates a new AST node of the specified type; nodes count against the document's budget
 ASTNode* ASTManager::newNode(NodeType type) {
+    PROFILE_NODE(type);
+    chargeNode();
     return new ASTNode(type);
 }
 
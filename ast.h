@@ -41,7 +41,11 @@ enum NodeType {
     HRULE_H,              //! Horizontal rule node
     HREF_H,               //! Hyperlink node
     TEXT_H,               //! Text node with formatting (e.g., bold, italic)
-    CODE_H                //! Code node (e.g., for verbatim content)
+    CODE_H,               //! Code node (e.g., for verbatim content)
+    MATH_H,               //! Inline math node ($...$, \(...\))
+    DISPLAY_MATH_H,       //! Display math node ($$...$$, \[...\], equation environments)
+    CITE_H,               //! Citation node (\cite); data holds the comma-separated keys, attributes the optional note
+    NODE_TYPE_COUNT       //! Number of node types (not a node type itself)
 };
 
 //! Converts a NodeType enum value to a string for printing purposes
@@ -77,16 +81,26 @@ inline string nodeTypeToString(NodeType type) {
         case HREF_H: return "HREF_H";
         case TEXT_H: return "TEXT_H";
         case CODE_H: return "CODE_H";
+        case MATH_H: return "MATH_H";
+        case DISPLAY_MATH_H: return "DISPLAY_MATH_H";
+        case CITE_H: return "CITE_H";
         default: return "UNKNOWN_NODE_TYPE";
     }
 }
 
+//! A view into the input buffer; used to pass content (e.g., math bodies) through without copying
+struct TextSpan {
+    const char* ptr;                //! Start of the span in the input buffer
+    size_t len;                     //! Length of the span in bytes
+};
+
 //! ASTNode class represents a node in the AST
 class ASTNode {
 public:
     NodeType node_type;             //! Type of the node (e.g., SECTION_H, ITEM_H)
     string data;                    //! Data associated with the node (e.g., text content)
     string attributes;              //! Additional attributes (e.g., label, reference)
+    TextSpan span;                  //! Raw input span for passthrough nodes (e.g., MATH_H); valid while the input buffer lives
     vector<ASTNode *> children;     //! Child nodes
 
     //! Constructors
@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include "bib.h"
+#include "escape.h"
+#include "macro.h"
+#include "utf8.h"
+
+using namespace std;
+
+//! Runs `body` until at least `minSeconds` have passed and prints the throughput over `bytes` per run
+static double benchmark(const string& name, size_t bytes, const function<void()>& body, double minSeconds = 0.2) {
+    auto start = chrono::steady_clock::now();
+    size_t runs = 0;
+    double elapsed = 0;
+    do {
+        body();
+        runs++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < minSeconds);
+    double mbPerSecond = bytes * runs / elapsed / (1024.0 * 1024.0);
+    cout << name << "\t" << mbPerSecond << " MB/s" << endl;
+    return mbPerSecond;
+}
+
+//! Repeats `unit` until the text is at least `size` bytes long
+static string makeText(const string& unit, size_t size) {
+    string text;
+    while (text.size() < size) text += unit;
+    return text;
+}
+
+static volatile size_t sink;  //! Keeps the optimizer from dropping benchmarked work
+
+int main() {
+    const size_t SIZE = 1 << 20;
+    string clean = makeText("The institute is renowned for its rigorous academic programs. ", SIZE);
+    string markup = makeText("Use a_b or *c* in `code` | cells [1] ", SIZE);
+    string cjk = makeText("\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE\xE6\x96\x87\xE6\x9B\xB8 ", SIZE);
+
+    //! Markdown escaping: clean text should run close to a plain copy
+    string out;
+    out.reserve(2 * SIZE);
+    benchmark("memcpy (clean text)", clean.size(), [&]() {
+        out.assign(clean.data(), clean.size());
+        sink = out.size();
+    });
+    for (EscapeContext context : {ESCAPE_PARAGRAPH, ESCAPE_TABLE_CELL}) {
+        string name = context == ESCAPE_PARAGRAPH ? "paragraph" : "table cell";
+        benchmark("escape " + name + " (clean text)", clean.size(), [&]() {
+            out.clear();
+            appendEscaped(out, clean.data(), clean.size(), context);
+            sink = out.size();
+        });
+        benchmark("escape " + name + " (markup-heavy text)", markup.size(), [&]() {
+            out.clear();
+            appendEscaped(out, markup.data(), markup.size(), context);
+            sink = out.size();
+        });
+    }
+
+    //! UTF-8 validation: ASCII only tests the high bits, multi-byte text runs the full block check and is several
+    //! times slower, though still far faster than parsing
+    benchmark("utf8 validate (ASCII)", clean.size(), [&]() {
+        sink = validateUtf8(clean.data(), clean.size()).size();
+    });
+    benchmark("utf8 validate (CJK)", cjk.size(), [&]() {
+        sink = validateUtf8(cjk.data(), cjk.size()).size();
+    });
+
+    //! Macro expansion: documents without definitions only pay for the scan, macro-heavy ones for the rewrite
+    string definitions =
+        "\\newcommand{\\iitd}{IIT Delhi}\n"
+        "\\newcommand{\\emphx}[1]{\\textit{#1}}\n"
+        "\\newcommand{\\pair}[2][x]{(#1, #2)}\n"
+        "\\def\\vect#1{\\textbf{#1}}\n";
+    string macroText = definitions + makeText("The \\iitd{} campus has \\emphx{labs}, \\pair{y} and \\vect{v} here. ", SIZE);
+    benchmark("macro scan (no definitions)", clean.size(), [&]() {
+        sink = macroExpander::hasDefinitions(clean.data(), clean.size());
+    });
+    benchmark("macro expand (macro-heavy text)", macroText.size(), [&]() {
+        macroExpander expander;
+        sink = expander.expand(macroText.data(), macroText.size()).size();
+    });
+
+    //! Bibliography: mapping and indexing a 50 MB .bib should take well under a second
+    char bibPath[] = "/tmp/bench-XXXXXX.bib";
+    int fd = mkstemps(bibPath, 4);
+    FILE* bibFile = fd < 0 ? nullptr : fdopen(fd, "wb");
+    if (bibFile) {
+        size_t bibSize = 0;
+        for (int i = 0; bibSize < 50 * SIZE; i++) {
+            char entry[512];
+            int len = snprintf(entry, sizeof(entry),
+                "@article{key%d,\n  author = {Author %d and Coauthor, {Second}},\n  title = {On the {Effects} of Item %d},\n"
+                "  journal = \"Journal of Examples\",\n  year = %d,\n  pages = {1--%d}\n}\n\n", i, i, i, 1950 + i % 70, i % 500);
+            fwrite(entry, 1, len, bibFile);
+            bibSize += len;
+        }
+        fclose(bibFile);
+        benchmark("bib open + index (50 MB)", bibSize, [&]() {
+            bibDatabase bib;
+            bib.open(bibPath);
+            sink = bib.entries();
+        }, 1.0);
+        remove(bibPath);
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include "bib.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//! Value of a field, or an empty string if the entry does not have it
+std::string bibEntry::field(const std::string& name) const {
+    auto found = fields.find(name);
+    return found == fields.end() ? "" : found->second;
+}
+
+//! Where the work appeared: journal, book title, publisher or howpublished, whichever is present first
+std::string bibEntry::venue() const {
+    static const char* VENUE_FIELDS[] = { "journal", "booktitle", "publisher", "howpublished", "school", "institution" };
+    for (const char* name : VENUE_FIELDS) {
+        auto found = fields.find(name);
+        if (found != fields.end() && !found->second.empty()) return found->second;
+    }
+    return "";
+}
+
+//! Keys of a \cite node ("a,b,c"), in order and without empty entries
+std::vector<std::string> splitCitationKeys(const std::string& keys) {
+    std::vector<std::string> result;
+    size_t start = 0;
+    while (start <= keys.size()) {
+        size_t comma = keys.find(',', start);
+        if (comma == std::string::npos) comma = keys.size();
+        if (comma > start) result.push_back(keys.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return result;
+}
+
+static bool isSpace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+static std::string lowerCase(const char* begin, const char* end) {
+    std::string result(begin, end);
+    for (auto& ch : result) ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+    return result;
+}
+
+//! End of an entry whose body opens with `open` at `p`: the matching '}' or ')' outside of braces; nullptr if truncated
+static const char* entryEnd(const char* p, const char* end, char open) {
+    int braces = 0;
+    for (p++; p < end; p++) {
+        char ch = *p;
+        if (ch == '{') braces++;
+        else if (ch == '}') {
+            if (braces == 0 && open == '{') return p;
+            braces--;
+        } else if (ch == ')' && open == '(' && braces == 0) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+bibDatabase::~bibDatabase() {
+    clear();
+}
+
+//! Unmaps the file and forgets its entries
+void bibDatabase::clear() {
+    if (data) munmap(const_cast<char*>(data), size);
+    data = nullptr;
+    size = 0;
+    index.clear();
+    problems.clear();
+}
+
+//! The '@' of the next line that starts with one (after blanks) from `p` on, or nullptr
+static const char* nextLineEntry(const char* p, const char* end) {
+    while ((p = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr) {
+        for (p++; p < end && (*p == ' ' || *p == '\t'); p++) {}
+        if (p < end && *p == '@') return p;
+    }
+    return nullptr;
+}
+
+//! Maps `filename` and indexes its entries; returns false if the file cannot be opened or mapped
+bool bibDatabase::open(const std::string& filename) {
+    clear();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        return true;
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    data = static_cast<const char*>(mapping);
+    size = info.st_size;
+
+    //! Indexing reads the file front to back once; lookups afterwards touch single entries
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    const char* end = data + size;
+    //! Every entry starts with '@'; counting them first sizes the index once instead of rehashing as it grows
+    size_t candidates = 0;
+    for (const char* at = data; (at = static_cast<const char*>(memchr(at, '@', end - at))) != nullptr; at++) candidates++;
+    index.reserve(candidates);
+    const char* p = data;
+    while ((p = static_cast<const char*>(memchr(p, '@', end - p))) != nullptr) {
+        const char* at = p++;
+        const char* typeEnd = p;
+        while (typeEnd < end && isalpha(static_cast<unsigned char>(*typeEnd))) typeEnd++;
+        const char* open = typeEnd;
+        while (open < end && isSpace(*open)) open++;
+        if (typeEnd == p || open == end || (*open != '{' && *open != '(')) continue;
+
+        const char* close = entryEnd(open, end, *open);
+        if (!close) {
+            //! Unbalanced braces would swallow the rest of the file; skip to the next entry and keep indexing
+            const char* name = open + 1;
+            while (name < end && isSpace(*name)) name++;
+            const char* nameEnd = name;
+            while (nameEnd < end && nameEnd - name < 64 && *nameEnd != ',' && !isSpace(*nameEnd)) nameEnd++;
+            size_t line = 1 + std::count(data, at, '\n');
+            problems.push_back("line " + std::to_string(line) + ": @" + std::string(p, typeEnd) + *open +
+                               std::string(name, nameEnd) + " is not closed, skipped");
+            p = nextLineEntry(open, end);
+            if (!p) break;
+            continue;
+        }
+        std::string type = lowerCase(p, typeEnd);
+        p = close + 1;
+        if (type == "comment" || type == "string" || type == "preamble") continue;
+
+        const char* key = open + 1;
+        while (key < close && isSpace(*key)) key++;
+        const char* keyEnd = key;
+        while (keyEnd < close && *keyEnd != ',' && !isSpace(*keyEnd)) keyEnd++;
+        if (keyEnd == key) continue;
+        entrySpan span = { static_cast<size_t>(at - data), static_cast<size_t>(close + 1 - at) };
+        index.emplace(std::string(key, keyEnd), span);  //! Like BibTeX, the first of duplicate keys wins
+    }
+    madvise(mapping, size, MADV_RANDOM);
+    return true;
+}
+
+//! Appends a field value part (braced, quoted or bare) to `value` without its delimiters and inner braces
+static const char* parseValuePart(const char* p, const char* end, std::string& value) {
+    if (*p == '{' || *p == '"') {
+        char close = *p == '{' ? '}' : '"';
+        int braces = 0;
+        for (p++; p < end; p++) {
+            char ch = *p;
+            if (ch == '{') { braces++; continue; }
+            if (ch == '}') {
+                if (braces == 0 && close == '}') return p + 1;
+                braces--;
+                continue;
+            }
+            if (ch == '"' && close == '"' && braces == 0) return p + 1;
+            if (isSpace(ch)) {
+                if (!value.empty() && value.back() != ' ') value += ' ';
+            } else {
+                value += ch;
+            }
+        }
+        return end;
+    }
+    //! Bare number or @string abbreviation
+    const char* start = p;
+    while (p < end && !isSpace(*p) && *p != ',' && *p != '#' && *p != '}' && *p != ')') p++;
+    value.append(start, p);
+    return p;
+}
+
+//! Parses the entry with `key` into `entry`; returns false if there is none
+bool bibDatabase::lookup(const std::string& key, bibEntry& entry) const {
+    auto found = index.find(key);
+    if (found == index.end()) return false;
+    const char* p = data + found->second.offset + 1;
+    const char* end = data + found->second.offset + found->second.length - 1;  //! Stops before the closing delimiter
+
+    const char* typeEnd = p;
+    while (typeEnd < end && isalpha(static_cast<unsigned char>(*typeEnd))) typeEnd++;
+    entry.type = lowerCase(p, typeEnd);
+    entry.key = key;
+    entry.fields.clear();
+
+    p = static_cast<const char*>(memchr(typeEnd, ',', end - typeEnd));
+    while (p && p < end) {
+        while (p < end && (isSpace(*p) || *p == ',')) p++;
+        const char* nameEnd = p;
+        while (nameEnd < end && !isSpace(*nameEnd) && *nameEnd != '=') nameEnd++;
+        if (nameEnd == p) break;
+        std::string name = lowerCase(p, nameEnd);
+        p = nameEnd;
+        while (p < end && isSpace(*p)) p++;
+        if (p >= end || *p != '=') break;
+        p++;
+
+        std::string value;
+        while (true) {
+            while (p < end && isSpace(*p)) p++;
+            if (p >= end) break;
+            p = parseValuePart(p, end, value);
+            while (p < end && isSpace(*p)) p++;
+            if (p < end && *p == '#') p++;  //! Concatenation
+            else break;
+        }
+        if (!value.empty() && value.back() == ' ') value.pop_back();
+        entry.fields[name] = value;
+    }
+    return true;
+}
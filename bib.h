@@ -0,0 +1,64 @@
+#ifndef BIB_H
+#define BIB_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//! One parsed .bib entry
+struct bibEntry {
+    std::string type;                           //! Entry type in lower case (e.g., "article")
+    std::string key;                            //! Citation key
+    std::map<std::string, std::string> fields;  //! Lower-case field name -> value without braces or quotes
+
+    //! Value of a field, or an empty string if the entry does not have it
+    std::string field(const std::string& name) const;
+
+    //! Where the work appeared: journal, book title, publisher or howpublished, whichever is present first
+    std::string venue() const;
+};
+
+//! A .bib file mapped into memory and indexed by citation key.
+//! The index only records where each entry lies in the mapping; entries are parsed on lookup.
+//! After open() the database is read-only, so one instance can be shared by all conversion threads.
+class bibDatabase {
+    const char* data;       //! Start of the mapping (nullptr when nothing is open)
+    size_t size;            //! Length of the mapping in bytes
+    struct entrySpan {
+        size_t offset;      //! Offset of the '@' that starts the entry
+        size_t length;      //! Length of the entry up to and including its closing delimiter
+    };
+    std::unordered_map<std::string, entrySpan> index;
+    std::vector<std::string> problems;  //! Entries skipped while indexing
+
+    //! Unmaps the file and forgets its entries
+    void clear();
+
+    bibDatabase(const bibDatabase&);
+    bibDatabase& operator=(const bibDatabase&);
+
+public:
+    bibDatabase() : data(nullptr), size(0) {}
+    ~bibDatabase();
+
+    //! Maps `filename` and indexes its entries; returns false if the file cannot be opened or mapped.
+    //! An entry whose braces never balance is reported in warnings() and skipped up to the next line starting with '@'.
+    //! Opening another file replaces what was open before, also when that fails.
+    bool open(const std::string& filename);
+
+    //! Problems found while indexing, one per skipped entry
+    const std::vector<std::string>& warnings() const { return problems; }
+
+    //! Parses the entry with `key` into `entry`; returns false if there is none
+    bool lookup(const std::string& key, bibEntry& entry) const;
+
+    //! Number of indexed entries
+    size_t entries() const { return index.size(); }
+};
+
+//! Keys of a \cite node ("a,b,c"), in order and without empty entries
+std::vector<std::string> splitCitationKeys(const std::string& keys);
+
+#endif //! BIB_H
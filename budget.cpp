@@ -0,0 +1,97 @@
+#include "budget.h"
+#include <chrono>
+#include <cstdio>
+
+//! Reading the clock is the only costly check, so the wall time is looked at every CLOCK_INTERVAL ticks
+static const unsigned CLOCK_INTERVAL = 256;
+
+//! Accounting for the document the current thread is working on
+struct budgetState {
+    bool active;
+    resourceLimits limits;
+    size_t nodes;
+    size_t depth;
+    unsigned ticks;
+    std::chrono::steady_clock::time_point deadline;
+    std::string failure;
+};
+
+static thread_local budgetState current;
+
+//! Starts accounting for a new document on this thread
+void beginBudget(const resourceLimits& limits) {
+    current.active = true;
+    current.limits = limits;
+    current.nodes = current.depth = 0;
+    current.ticks = 0;
+    current.deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(limits.maxSeconds));
+    current.failure.clear();
+}
+
+//! Stops accounting on this thread
+void endBudget() {
+    current.active = false;
+    current.failure.clear();
+}
+
+//! Why the current document was stopped, or an empty string while it is within its limits
+const std::string& budgetFailure() {
+    return current.failure;
+}
+
+//! Records the first limit that was hit
+static void fail(const std::string& reason) {
+    if (current.failure.empty()) current.failure = reason;
+}
+
+//! Checks the wall time every CLOCK_INTERVAL calls; returns true if a limit has been hit
+static bool overBudget() {
+    if (!current.active) return false;
+    if (!current.failure.empty()) return true;
+    if (current.limits.maxSeconds > 0 && ++current.ticks % CLOCK_INTERVAL == 0 &&
+        std::chrono::steady_clock::now() > current.deadline) {
+        char reason[64];
+        snprintf(reason, sizeof(reason), "time limit of %.1f s exceeded", current.limits.maxSeconds);
+        fail(reason);
+    }
+    return !current.failure.empty();
+}
+
+//! Counts one AST node; never throws (see budget.h)
+void chargeNode() {
+    if (current.active && current.limits.maxNodes > 0 && ++current.nodes > current.limits.maxNodes) {
+        fail("node limit of " + std::to_string(current.limits.maxNodes) + " exceeded");
+    }
+}
+
+//! Called by the scanner once per token; true once a limit has been hit and the parse must stop
+bool budgetTick() {
+    return overBudget();
+}
+
+//! Throws budgetExceeded if a limit has been hit or the wall time is up
+void checkBudget() {
+    if (overBudget()) throw budgetExceeded(current.failure);
+}
+
+//! Throws budgetExceeded if `bytes` of output exceed the limit
+void checkOutput(size_t bytes) {
+    if (current.active && current.limits.maxOutputBytes > 0 && bytes > current.limits.maxOutputBytes) {
+        fail("output limit of " + std::to_string(current.limits.maxOutputBytes) + " bytes exceeded");
+        throw budgetExceeded(current.failure);
+    }
+}
+
+depthScope::depthScope() {
+    if (!current.active) return;
+    if (current.limits.maxDepth > 0 && current.depth >= current.limits.maxDepth) {
+        fail("nesting depth limit of " + std::to_string(current.limits.maxDepth) + " exceeded");
+        throw budgetExceeded(current.failure);
+    }
+    current.depth++;
+}
+
+depthScope::~depthScope() {
+    if (current.depth > 0) current.depth--;
+}
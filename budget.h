@@ -0,0 +1,53 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+//! Limits on the work spent on one document; 0 means no limit
+struct resourceLimits {
+    size_t maxNodes;          //! AST nodes created for the document
+    size_t maxDepth;          //! Nesting depth of the AST the converter descends into
+    size_t maxOutputBytes;    //! Size of the macro-expanded source and of each output format
+    double maxSeconds;        //! Wall time from the start of the document
+};
+
+//! Raised outside the parser when the current document exceeds one of its limits; what() names the limit
+class budgetExceeded : public std::runtime_error {
+public:
+    explicit budgetExceeded(const std::string& reason) : std::runtime_error(reason) {}
+};
+
+//! Budgets are kept per thread, so every batch worker accounts for the document it is converting.
+//! Outside of beginBudget/endBudget all checks pass.
+
+//! Starts accounting for a new document on this thread
+void beginBudget(const resourceLimits& limits);
+
+//! Stops accounting on this thread
+void endBudget();
+
+//! Why the current document was stopped, or an empty string while it is within its limits
+const std::string& budgetFailure();
+
+//! Counts one AST node. Never throws, so it is safe inside parser actions; the scanner ends the parse instead.
+void chargeNode();
+
+//! Called by the scanner once per token; true once a limit has been hit and the parse must stop
+bool budgetTick();
+
+//! Throws budgetExceeded if a limit has been hit or the wall time is up; cheap enough to call per node
+void checkBudget();
+
+//! Throws budgetExceeded if `bytes` of output exceed the limit
+void checkOutput(size_t bytes);
+
+//! Counts one level of converter recursion for its lifetime; throws budgetExceeded past the depth limit
+class depthScope {
+public:
+    depthScope();
+    ~depthScope();
+};
+
+#endif //! BUDGET_H
@@ -1,11 +1,17 @@
 #include "converter.h"
+#include "emitter.h"
+#include "profiler.h"
+#include "mathmode.h"
+#include "budget.h"
+#include <memory>
 #include <sstream>
 #include <fstream>
+#include <cstdio>
+#include <cctype>
+#include <thread>
+#include <atomic>
+#include <sys/stat.h>
 
-int section_no = 0;          //! Counter for sections
-int subsection_no = 0;      //! Counter for subsections
-int subsubsection_no = 0;   //! Counter for subsubsections
-int nested = 0;             //! Counter for nested lists
 //! Converts an integer to a string
 std::string myString(int n) {
     std::stringstream ss;
@@ -14,7 +20,7 @@ std::string myString(int n) {
 }
 
 //! Constructor initializes the mapping of node types to their Markdown representations
-converter::converter() {
+converter::converter() : mathTransform(false), bibliography(nullptr) {
     myMapping[SECTION_H] = "##";              //! Section (Markdown heading level 2)
     myMapping[SUBSECTION_H] = "###";          //! Subsection (Markdown heading level 3)
     myMapping[SUBSUBSECTION_H] = "####";      //! Subsubsection (Markdown heading level 4)
@@ -37,199 +43,145 @@ converter::converter() {
     myMapping[VERBATIM_H] = "```";            //! Verbatim text (Markdown code block)
     myMapping[HRULE_H] = "---";               //! Horizontal rule (Markdown horizontal rule)
     myMapping[HREF_H] = "";                   //! Hyperlink (Markdown link placeholder)
+    myMapping[MATH_H] = "$";                  //! Inline math (Markdown math delimiter)
+    myMapping[DISPLAY_MATH_H] = "$$";         //! Display math (Markdown math block delimiter)
+    myMapping[SQRT_H] = "√";                  //! Square root (plain-text math transformation)
+    myMapping[CITE_H] = "";                   //! Citation (numbered link into the references section)
 }
 
-//! Converts the entire AST starting from the root node
-std::string converter::traversal(ASTNode* root) {
-    if (!root) return "";  //! Return empty string if root is null
-    int type = root->node_type;
-    switch (type) {
-        case ITEM_H: return traversal(root->children[0]);  //! Directly return item data
-        case STRING_H: 
-            {
-                string str = root->data; 
-
-                // Traverse children if they exist
-                if (!root->children.empty()) {
-                    for (auto child : root->children) {
-                        if (child) { // Ensure child is not nullptr
-                            str = str + " " + traversal(child);
-                        }
-                    }
-
-                    // Check if the first child has children
-                    if (root->children.size() > 0 && !root->children[0]->children.empty()) {
-                        for (auto child : root->children[0]->children) {
-                            if (child) { // Ensure child is not nullptr
-                                str = str + " " + traversal(child);
-                            }
-                        }
-                    }
-                }
-
-                return str;
-            }
-        case SECTION_H: return traverseSection(root, type);  //! Handle section nodes
-        case SUBSECTION_H: return traverseSubSection(root, type);  //! Handle subsection nodes
-        case SUBSUBSECTION_H: return traverseSubsubSection(root, type); //! Handle subsubsection nodes
-        case ITEMIZE_H://! Handle list nodes
-        case ENUMERATE_H:{ 
-            nested++; 
-            string res = traverseList(root, type);
-            std::string ans;
-            std::string prevLine;
-            std::stringstream ss(res);
-            std::string line;
-            
-            while (std::getline(ss, line)) {
-                // Trim leading whitespaces
-                std::string trimmed = line;
-                trimmed.erase(trimmed.begin(), std::find_if(trimmed.begin(), trimmed.end(), [](int ch) {
-                    return !std::isspace(ch);
-                }));
-
-                // If the line is a number followed by a period, followed by whitespace, and it's not the first line,
-                // check the previous line. If the previous line ends with a number and a period, skip this line.
-                if (trimmed == "1.") {
-                    // Skip this line if the previous line ended with a number and a period
-                    if (prevLine.empty() || prevLine.back() != '.') {
-                        continue;
-                    }
-                }
-
-                // Append the line to the result string
-                ans += line + "\n";
-
-                // Store the current line as the previous line for the next iteration
-                prevLine = line;
-            }
-
-            
-            
-            return ans;
-        }  
-        case VERBATIM_H: return traverseVerbatim(root, type);  //! Handle verbatim nodes
-        case TEXTBF_H:
-        case TEXTIT_H:return traverseFont(root, type);  //! Handle font formatting nodes
-        case TITLE_H: return traverseTitle(root, type);  //! Handle title nodes
-        case DATE_H: return traverseDate(root, type);  //! Handle date nodes
-        case FIGURE_H: return traverseFigure(root, type);  //! Handle figure nodes
-        case REF_H: return traverseReference(root, type);  //! Handle reference nodes
-        case HRULE_H: return "\n\n---\n\n";  //! Handle horizontal rules
-        case PAR_H: return traverseParagraph(root, type);  //! Handle paragraph nodes
-        case HREF_H: return traverseHref(root, type);  //! Handle hyperlink nodes
-        case TABULAR_H: return traverseTable(root, type);  //! Handle table nodes
-        default: return traverseChildren(root);  //! Handle unknown or other node types
-    }
-}
-
-//! Converts a SECTION node to Markdown format
-std::string converter::traverseSection(ASTNode* root, int type) {
-    section_no++;
-    subsection_no = 0;
-    subsubsection_no = 0;
-    return getMapping(type) + " " + myString(section_no) + " " + root->data + "\n\n" + traverseChildren(root) + "\n\n";
-}
-
-//! Converts a SUBSECTION node to Markdown format
-std::string converter::traverseSubSection(ASTNode* root, int type) {
-    subsection_no++;
-    subsubsection_no = 0;
-    return getMapping(type) + " " + myString(section_no) + "." + myString(subsection_no) + " " + root->data + "\n\n" + traverseChildren(root) + "\n\n";
-}
-
-//! Converts a SUBSUBSECTION node to Markdown format
-std::string converter::traverseSubsubSection(ASTNode* root, int type) {
-    subsubsection_no++;
-    return getMapping(type) + " " + myString(section_no) + "." + myString(subsection_no) + "." + myString(subsubsection_no) + " " + root->data + "\n\n" + traverseChildren(root) + "\n\n";
+//! Converts a whole document in one walk; the Markdown emitter back-patches forward references at the end
+std::string converter::convert(ASTNode* root) {
+    markdownEmitter markdown(*this);
+    emitDocument(root, std::vector<emitter*>(1, &markdown));
+    headings = markdown.headings();
+    citations = markdown.citations();
+    return markdown.output();
 }
 
-//! Converts LIST nodes (either ITEMIZE or ENUMERATE) to Markdown format
-std::string converter::traverseList(ASTNode* root, int type) {
-    std::string result = "\n";
-    std::string indent(nested, '\t');  //! Create indentation based on nesting level
-
-    if (type == ITEMIZE_H) {
-        //! Handle unordered list
-        string s = "-";
-        for(int i=1; i<nested; i++) s = "\t"+s;
-        for(auto child : root->children[0]->children) {
-            string str = traversal(child);
-            result += s + str + "\n";
-        }
-
-    } else {
-        //! Handle ordered list
-
-        string s = "1.";
-        for(int i=1; i<nested; i++) s = "\t"+s;
-        for(auto child : root->children[0]->children) {
-            string str = traversal(child);
-            result += s + str + "\n";
-        }
-
+//! Lower-case, dash-separated form of a heading, used for file names and anchors
+static std::string slugify(const std::string& text) {
+    std::string slug;
+    for (unsigned char ch : text) {
+        if (std::isalnum(ch) || ch >= 0x80) slug += std::tolower(ch);
+        else if (!slug.empty() && slug.back() != '-') slug += '-';
     }
-    nested--;
-    return result+"\n";
+    while (!slug.empty() && slug.back() == '-') slug.pop_back();
+    return slug;
 }
 
-
-//! Converts VERBATIM nodes (code blocks) to Markdown format
-std::string converter::traverseVerbatim(ASTNode* root, int type) {
-    return "\n\n" + getMapping(type) + "\n" + root->data + "\n" + getMapping(type) + "\n\n";
+//! Anchor that Markdown renderers generate for a heading such as "### 1.1 Overview"
+static std::string headingAnchor(const std::string& text) {
+    std::string anchor;
+    for (unsigned char ch : text) {
+        if (std::isalnum(ch) || ch >= 0x80 || ch == '-') anchor += std::tolower(ch);
+        else if (ch == ' ') anchor += '-';
+    }
+    return anchor;
 }
 
-//! Converts font formatting nodes (e.g., bold, italic) to Markdown format
-std::string converter::traverseFont(ASTNode* root, int type) {
-    return getMapping(type) + root->data + getMapping(type) + " ";
+//! Splits a document into the preamble and one chunk per top-level section, in the walk that drives `others`
+std::vector<sectionChunk> converter::splitSections(ASTNode* root, const std::vector<emitter*>& others) {
+    markdownEmitter markdown(*this, true);
+    std::vector<emitter*> backends(1, &markdown);
+    backends.insert(backends.end(), others.begin(), others.end());
+    emitDocument(root, backends);
+    headings = markdown.headings();
+    citations = markdown.citations();
+    return markdown.chunks();
 }
 
-//! Converts DATE nodes to Markdown format
-std::string converter::traverseDate(ASTNode* root, int type) {
-    if(root->data.empty()) return "";
-    return getMapping(type) + root->data + "\n\n";
+//! File name of the chunk of top-level section `section` in split mode
+std::string converter::chunkFile(int section, const std::string& title) {
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "%02d-", section);
+    return prefix + slugify(title) + ".md";
 }
 
-//! Converts TITLE nodes to Markdown format
-std::string converter::traverseTitle(ASTNode* root, int type) {
-    if(root->data.empty()) return "";
-    return getMapping(type) + " " + root->data + "\n\n";
+//! Table of contents with one nested bullet per heading, linking into the split files
+std::string converter::tableOfContents() {
+    std::string toc = "## Contents\n\n";
+    for (auto& heading : headings) {
+        std::string text = heading.number + " " + heading.title;
+        toc += std::string(2 * (heading.level - 1), ' ') + "- [";
+        appendEscaped(toc, text.data(), text.size(), ESCAPE_HEADING);
+        toc += "](" + heading.file;
+        if (heading.level > 1) toc += "#" + headingAnchor(text);
+        toc += ")\n";
+    }
+    return toc;
 }
 
-//! Converts FIGURE nodes to Markdown format
-std::string converter::traverseFigure(ASTNode* root, int type) {
-    std::string result = getMapping(FIGURE_H) + "(" + root->data + ")";
-    for (auto& child : root->children) {
-        if (child->node_type == CAPTION_H) {
-            result += " " + getMapping(CAPTION_H) + " \"" + child->data + "\"";
+//! Drops the lines of a rendered list that hold nothing but an "1." marker, unless the line before ends in '.'
+std::string converter::cleanListMarkers(const std::string& list) {
+    std::string ans;
+    std::string prevLine;
+    std::stringstream ss(list);
+    std::string line;
+
+    while (std::getline(ss, line)) {
+        // Trim leading whitespaces
+        std::string trimmed = line;
+        trimmed.erase(trimmed.begin(), std::find_if(trimmed.begin(), trimmed.end(), [](int ch) {
+            return !std::isspace(ch);
+        }));
+
+        // If the line is a number followed by a period, followed by whitespace, and it's not the first line,
+        // check the previous line. If the previous line ends with a number and a period, skip this line.
+        if (trimmed == "1.") {
+            // Skip this line if the previous line ended with a number and a period
+            if (prevLine.empty() || prevLine.back() != '.') {
+                continue;
+            }
         }
-    }
-    return result + "\n\n";
-}
 
+        // Append the line to the result string
+        ans += line + "\n";
 
-//! Converts HREF nodes (hyperlinks) to Markdown format
-std::string converter::traverseHref(ASTNode* root, int type) {
-    std::string data = root->data, link="", label="";
-    bool flag = true;
-    for(auto x: data){
-        if(x == '#'){ flag = false; continue;}
-        if(flag) link += x;
-        else label += x;
+        // Store the current line as the previous line for the next iteration
+        prevLine = line;
     }
-    return getMapping(HREF_H) + "[" + label + "]" + "(" + link + ")" + " \n";
+    return ans;
 }
 
-//! Converts REFERENCE nodes to Markdown format
-std::string converter::traverseReference(ASTNode* root, int type) {
-    return getMapping(REF_H) + root->data + "\n\n";
+//! Lists the cited entries as "Authors. *Title*. Venue, Year." with an anchor for the citation links.
+//! Keys missing from the bibliography are listed as they are.
+std::string converter::referencesSection() {
+    return referencesSection(citations);
 }
 
-//! Traverses and processes all child nodes
-std::string converter::traverseChildren(ASTNode* root) {
-    std::string result;
-    for (auto& child : root->children) {
-        result += traversal(child);
+//! References section for the keys in `cited`, numbered in that order
+std::string converter::referencesSection(const std::vector<std::string>& cited) {
+    if (cited.empty()) return "";
+    std::string result = "\n\n## References\n\n";
+    bibEntry entry;
+    for (size_t i = 0; i < cited.size(); i++) {
+        const std::string& key = cited[i];
+        result += myString(i + 1) + ". <a id=\"ref-" + key + "\"></a>";
+        if (!bibliography || !bibliography->lookup(key, entry)) {
+            appendEscaped(result, key.data(), key.size(), ESCAPE_LIST_ITEM);
+            result += "\n";
+            continue;
+        }
+        std::string author = entry.field("author"), title = entry.field("title"), venue = entry.venue(), year = entry.field("year");
+        if (!author.empty()) {
+            appendEscaped(result, author.data(), author.size(), ESCAPE_LIST_ITEM);
+            result += ". ";
+        }
+        if (!title.empty()) {
+            result += "*";
+            appendEscaped(result, title.data(), title.size(), ESCAPE_LIST_ITEM);
+            result += "*. ";
+        }
+        if (!venue.empty()) {
+            appendEscaped(result, venue.data(), venue.size(), ESCAPE_LIST_ITEM);
+            result += year.empty() ? ". " : ", ";
+        }
+        if (!year.empty()) {
+            appendEscaped(result, year.data(), year.size(), ESCAPE_LIST_ITEM);
+            result += ".";
+        }
+        while (!result.empty() && result.back() == ' ') result.pop_back();
+        result += "\n";
     }
     return result;
 }
@@ -239,104 +191,68 @@ std::string converter::getMapping(int type) {
     return myMapping[type];
 }
 
-//! Converts TABLE nodes to Markdown format
-std::string converter::traverseTable(ASTNode* root, int type) {
-    std::string result;
-    int count = 0;
-    //! Iterate through all rows in the table
-    for (auto row : root->children) {
-        if (row->node_type == ROW_H) {
-            std::string rowResult;
-            //! Iterate through all cells in the row
-            for (auto cell : row->children) {
-                if (cell->node_type == CELL_H) {
-                    //! Extract cell data and add it to the row string
-                    std::string cellData = " | ";
-                    for (auto innerCell : cell->children) {
-                        if (innerCell->node_type == CELL_H) {
-                            cellData += traversal(innerCell) + " | ";
-                        }
-                        count++;
-                    }
-
-                    //! Add cell data to the row with formatting
-                    rowResult += cellData + " | ";
-                }
-            }
-            //! Trim the last pipe character and add a newline after the row
-            if (!rowResult.empty()) {
-                rowResult = rowResult.substr(0, rowResult.length() - 3); //! Remove trailing " | "
-            }
-            rowResult += "\n";
-            result += rowResult;
-        }
-    }
-
-    for (auto row : root->children[0]->children) {
-        if (row->node_type == ROW_H) {
-            std::string rowResult;
+//! Adds the line of dashes that marks the first row of the table rendered from output[start] on as its header
+void converter::insertHeaderSeparator(std::string& output, size_t start, int columns) {
+    size_t newline = output.find('\n', start);
+    if (newline == std::string::npos) return;
+    size_t pos = newline - start;
+    std::string separator(pos, '-'); // Create a separator line of dashes
 
-            //! Iterate through all cells in the row
-            for (auto cell : row->children) {
-                if (cell->node_type == CELL_H) {
-                    //! Extract cell data and add it to the row string
-                    std::string cellData = " | ";
-                    for (auto innerCell : cell->children) {
-                        if (innerCell->node_type == CELL_H) {
-                            cellData += traversal(innerCell)+" | ";
-                        }
-                    }
+    // Add '|' separators for each column
+    size_t columnWidth = columns > 0 ? pos / columns : pos; // Approximate width of each column
 
-                    //! Add cell data to the row with formatting
-                    rowResult += cellData + " | ";
-                }
-            }
-            //! Trim the last pipe character and add a newline after the row
-            if (!rowResult.empty()) {
-                rowResult = rowResult.substr(0, rowResult.length() - 3); 
-            }
-            rowResult += "\n";
-            result += rowResult;
-        }
+    for (int i = 1; i < columns; ++i) {
+        separator[i * columnWidth] = '|';
     }
 
-    //! Adding formatting (e.g., column separators)
-    if (!result.empty()) {
-    // Add a separator line after the header (first row)
-        size_t pos = result.find('\n');
-        if (pos != std::string::npos) {
-            std::string separator(pos, '-'); // Create a separator line of dashes
+    output.insert(newline + 1, separator + "\n"); // Insert after the first row
+}
 
-            // Add '|' separators for each column
-            size_t columnWidth = pos / count; // Approximate width of each column
+//! Appends MATH and DISPLAY_MATH nodes to `out` by copying the math body straight from the input span, or by
+//! rendering it as plain text when the transformation is enabled
+void converter::convertMath(std::string& out, ASTNode* root, EscapeContext context) {
+    int type = root->node_type;
+    if (mathTransform) {
+        std::unique_ptr<ASTNode> math(parseMath(root->span));
+        if (type == DISPLAY_MATH_H) out += "\n\n";
+        convertMathTree(out, math.get(), context);
+        out += type == DISPLAY_MATH_H ? "\n\n" : " ";
+        return;
+    }
 
-            for (int i = 1; i < count; ++i) {
-                separator[i * columnWidth] = '|';
-            }
+    const std::string& delimiter = myMapping[type];
+    out.reserve(out.size() + root->span.len + 2 * delimiter.size() + 4);
+    if (type == DISPLAY_MATH_H) out += "\n\n" + delimiter + "\n";
+    else out += delimiter;
+    out.append(root->span.ptr, root->span.len);
+    if (type == DISPLAY_MATH_H) out += "\n" + delimiter + "\n\n";
+    else out += delimiter + " ";
+}
 
-            result.insert(pos + 1, separator + "\n"); // Insert after the first row
-        }
-    }
+//! Appends the TEXT_H, STRING_H and SQRT_H nodes of parsed math to `out`, e.g. \sqrt[3]{x} -> 3√(x)
+void converter::convertMathTree(std::string& out, ASTNode* root, EscapeContext context) {
+    PROFILE_NODE(root->node_type);
+    depthScope depth;
+    checkBudget();
+    if (root->node_type == STRING_H) appendEscaped(out, root->data.data(), root->data.size(), context);
+    if (root->node_type == SQRT_H) out += root->attributes + getMapping(SQRT_H) + "(";
+    for (auto child : root->children) convertMathTree(out, child, context);
+    if (root->node_type == SQRT_H) out += ")";
+}
 
-    return result + "\n\n";
+//! Enables or disables the plain-text math transformation
+void converter::setMathTransform(bool enabled) {
+    mathTransform = enabled;
 }
 
-//! Converts PARAGRAPH nodes to Markdown format
-std::string converter::traverseParagraph(ASTNode* root, int type) {
-    std::string result;
-    ASTNode* temp = root->children[0];
-    for (auto& child : temp->children) {
-        result += traverseFont(child, child->node_type); 
-    }
-    // for (auto& child : root->children) {
-    //     result += "\n\n"+traverseFont(child, child->node_type); 
-    // }
-    
-    return result + "\n\n";
+//! Sets the bibliography \cite keys are looked up in; nullptr lists only the keys
+void converter::setBibliography(const bibDatabase* bib) {
+    bibliography = bib;
 }
 
 //! Writes the converted Markdown content to a specified file
 void converter::printMarkdown(const std::string& s, const std::string& filename) {
+    PROFILE_PHASE(PHASE_WRITE);
     std::ofstream file(filename);
     if (file.is_open()) {
         file << s;
@@ -345,3 +261,40 @@ void converter::printMarkdown(const std::string& s, const std::string& filename)
         std::cerr << "Unable to open file: " << filename << std::endl;
     }
 }
+
+//! Writes one file with a single buffered write; returns false if it cannot be written
+static bool writeFile(const std::string& path, const std::string& content) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(content.data(), 1, content.size(), file) == content.size();
+    return fclose(file) == 0 && ok;
+}
+
+//! Writes the chunks of a split document concurrently: each writer thread takes a batch of files.
+//! The index file gets the preamble followed by the table of contents and the references.
+bool converter::printSplitMarkdown(const std::vector<sectionChunk>& chunks, const std::string& directory) {
+    PROFILE_PHASE(PHASE_WRITE);
+    mkdir(directory.c_str(), 0755);
+    std::string index = chunks.empty() ? "" : chunks[0].markdown;
+    index += tableOfContents();
+    index += referencesSection();
+
+    std::atomic<bool> ok(true);
+    size_t workers = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), chunks.size()));
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers; w++) {
+        threads.emplace_back([&, w]() {
+            PROFILE_PHASE(PHASE_WRITE);
+            for (size_t i = w; i < chunks.size(); i += workers) {
+                const std::string& content = i == 0 ? index : chunks[i].markdown;
+                std::string path = directory + "/" + chunks[i].file;
+                if (!writeFile(path, content)) {
+                    ok = false;
+                    std::cerr << "Unable to open file: " << path << std::endl;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    return ok;
+}
@@ -2,46 +2,90 @@
 #define CONVERTER_H
 
 #include "ast.h"
+#include "bib.h"
+#include "escape.h"
 #include <string>
 #include <map>
+#include <vector>
 
-//! Converter class for traversing AST nodes and converting them to a Markdown-like format
+//! A heading recorded during conversion, used to build the table of contents in split mode
+struct headingEntry {
+    int level;              //! 1 for sections, 2 for subsections, 3 for subsubsections
+    std::string number;     //! Heading number (e.g., "2.1")
+    std::string title;      //! Heading text
+    std::string file;       //! Output file the heading is written to
+};
+
+//! One output file of split mode: a top-level section and everything up to the next one
+struct sectionChunk {
+    std::string file;       //! File name relative to the output directory
+    std::string markdown;   //! Converted content of the file
+};
+
+class emitter;
+
+//! Markdown conversion of whole documents. The Markdown itself is written by markdownEmitter (emitter.h) from the
+//! shared walk; the converter drives it, supplies the markup of each node type, math and the references section,
+//! and writes the results.
 class converter {
 private:
     std::map<int, std::string> myMapping;  //! Mapping of node types to their string representations
+    bool mathTransform;                    //! Parse math and rewrite it as plain text instead of passing it through
+    std::vector<headingEntry> headings;    //! Headings of the last conversion, for the table of contents
+    const bibDatabase* bibliography;       //! Entries cited with \cite (nullptr: references list only the keys)
+    std::vector<std::string> citations;    //! Keys cited by the last conversion, in order of first citation
+
+    //! Appends a tree built by parseMath to `out`: text runs escaped for `context`, square roots as n√(...)
+    void convertMathTree(std::string& out, ASTNode* root, EscapeContext context);
 
 public:
     //! Constructor
     converter();
 
-    //! Traversal method for converting the entire AST starting from the root node
-    std::string traversal(ASTNode* root);
-
-    //! Traversal methods for different node types, based on their type
-    std::string traverseSection(ASTNode* root, int type);        //! Handles SECTION nodes
-    std::string traverseSubSection(ASTNode* root, int type);     //! Handles SUBSECTION nodes
-    std::string traverseSubsubSection(ASTNode* root, int type);  //! Handles SUBSUBSECTION nodes
-    std::string traverseList(ASTNode* root, int type);           //! Handles LIST nodes (e.g., itemize, enumerate)
-    std::string traverseVerbatim(ASTNode* root, int type);       //! Handles VERBATIM nodes (e.g., code blocks)
-    std::string traverseFont(ASTNode* root, int type);           //! Handles font formatting nodes (e.g., bold, italic)
-    std::string traverseDate(ASTNode* root, int type);           //! Handles DATE nodes
-    std::string traverseTitle(ASTNode* root, int type);          //! Handles TITLE nodes
-    std::string traverseChildren(ASTNode* root);                 //! Handles traversal of child nodes
+    //! Converts a whole document, or any subtree on its own: numbering starts from scratch and forward references are
+    //! resolved. Conversion throws budgetExceeded if the document runs over the budget of the current thread (budget.h).
+    std::string convert(ASTNode* root);
 
     //! Retrieves the string representation for a given node type from the mapping
     std::string getMapping(int type);
 
-    //! Traversal methods for additional node types
-    std::string traverseReference(ASTNode* root, int type);     //! Handles REFERENCE nodes
-    std::string traverseLabel(ASTNode* root, int type);         //! Handles LABEL nodes
-    std::string traverseFigure(ASTNode* root, int type);        //! Handles FIGURE nodes
-    std::string traverseParagraph(ASTNode* root, int type);     //! Handles PARAGRAPH nodes
-    std::string traverseString(ASTNode* root, int type);        //! Handles STRING nodes
-    std::string traverseHref(ASTNode* root, int type);          //! Handles HREF (hyperlink) nodes
-    std::string traverseTable(ASTNode* root, int type);         //! Handles TABLE nodes (e.g., tabular environments)
+    //! Splits a document into one chunk per top-level section; the first chunk is the preamble (index file).
+    //! Labels and forward references are resolved across chunks. The backends in `others` (e.g., HTML and JSON written
+    //! next to the chunks) are driven by the same walk.
+    std::vector<sectionChunk> splitSections(ASTNode* root, const std::vector<emitter*>& others = std::vector<emitter*>());
+
+    //! File name of the chunk of top-level section `section` in split mode, e.g. "02-related-work.md"
+    static std::string chunkFile(int section, const std::string& title);
+
+    //! Table of contents linking every heading recorded by the last conversion to its file
+    std::string tableOfContents();
+
+    //! References section listing every entry cited by the last conversion in citation order; empty if nothing was cited
+    std::string referencesSection();
+    //! References section listing the entries of `cited` in that order (e.g., as numbered by emitDocument)
+    std::string referencesSection(const std::vector<std::string>& cited);
+
+    //! Appends a MATH or DISPLAY_MATH node to `out`, where it is in `context`, transforming it if enabled
+    void convertMath(std::string& out, ASTNode* root, EscapeContext context);
+
+    //! Drops the lines of a rendered list that hold a lone "1." marker
+    static std::string cleanListMarkers(const std::string& list);
+
+    //! Inserts the header separator into the table rendered from `start` of `output`, for `columns` columns
+    static void insertHeaderSeparator(std::string& output, size_t start, int columns);
+
+    //! Enables rewriting math as plain text (e.g., \sqrt{x} -> √(x)); by default math is passed through verbatim
+    void setMathTransform(bool enabled);
+
+    //! Looks up \cite keys in `bib`, which must outlive the converter; it is only read, so converters may share it
+    void setBibliography(const bibDatabase* bib);
 
     //! Outputs the converted Markdown content to a specified file
     void printMarkdown(const std::string& s, const std::string& filename);
+
+    //! Writes split-mode chunks into `directory` concurrently; the preamble chunk is followed by the table of contents
+    //! and the references
+    bool printSplitMarkdown(const std::vector<sectionChunk>& chunks, const std::string& directory);
 };
 
 #endif //! CONVERTER_H
@@ -0,0 +1,643 @@
+#include "emitter.h"
+#include "profiler.h"
+#include "budget.h"
+#include <cstdio>
+#include <functional>
+
+//! Marks a forward reference placeholder in Markdown and HTML output: REF_MARK key REF_MARK
+static const char REF_MARK = '\x1A';
+
+//! Section numbering kept by the walker; mirrors the numbering of the Markdown converter
+struct numbering {
+    int section, subsection, subsubsection, figure;
+    std::string current;      //! Number of the most recently numbered section or figure, for \label
+};
+
+static std::string toString(int n) {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%d", n);
+    return buffer;
+}
+
+//! Numbers `node` if it is a section or figure and records labels against the current number
+static void number(const ASTNode* node, numbering& counters, emitState& state) {
+    state.number.clear();
+    switch (node->node_type) {
+        case SECTION_H:
+            counters.section++;
+            counters.subsection = counters.subsubsection = 0;
+            state.number = toString(counters.section);
+            break;
+        case SUBSECTION_H:
+            counters.subsection++;
+            counters.subsubsection = 0;
+            state.number = toString(counters.section) + "." + toString(counters.subsection);
+            break;
+        case SUBSUBSECTION_H:
+            counters.subsubsection++;
+            state.number = toString(counters.section) + "." + toString(counters.subsection) + "." + toString(counters.subsubsection);
+            break;
+        case FIGURE_H:
+            counters.figure++;
+            state.number = toString(counters.figure);
+            break;
+        case LABEL_H:
+            state.labels[node->data] = counters.current;
+            return;
+        case CITE_H:
+            for (auto& key : splitCitationKeys(node->data)) {
+                if (state.citationNumbers.count(key)) continue;
+                state.citations.push_back(key);
+                state.citationNumbers[key] = static_cast<int>(state.citations.size());
+            }
+            return;
+        default:
+            return;
+    }
+    counters.current = state.number;
+}
+
+static void walk(ASTNode* node, const std::vector<emitter*>& backends, numbering& counters, emitState& state) {
+    //! A figure skipped after a syntax error has no image; like the converter, give it neither number nor output
+    if (node->node_type == FIGURE_H && node->data.empty() && node->children.empty()) return;
+    PROFILE_NODE(node->node_type);
+    depthScope depth;
+    checkBudget();
+    number(node, counters, state);
+    for (auto backend : backends) {
+        backend->enter(node, state);
+        checkOutput(backend->output().size());
+    }
+    state.parents.push_back(node);
+    for (auto child : node->children) {
+        if (child) walk(child, backends, counters, state);
+    }
+    state.parents.pop_back();
+    state.number.clear();
+    for (auto backend : backends) backend->leave(node, state);
+}
+
+//! Walks the AST once and drives every backend in `backends` from the same traversal
+void emitDocument(ASTNode* root, const std::vector<emitter*>& backends) {
+    emitState state;
+    numbering counters = {0, 0, 0, 0, ""};
+    for (auto backend : backends) backend->beginDocument();
+    if (root) walk(root, backends, counters, state);
+    for (auto backend : backends) backend->endDocument(state);
+}
+
+//! `path` with its file extension replaced by `extension` (e.g., out.md -> out.html)
+std::string replaceExtension(const std::string& path, const char* extension) {
+    size_t slash = path.find_last_of('/');
+    size_t dot = path.find_last_of('.');
+    std::string stem = dot != std::string::npos && (slash == std::string::npos || dot > slash + 1) ? path.substr(0, dot) : path;
+    return stem + "." + extension;
+}
+
+//! Replaces the placeholders of forward references in `output` with `link(key, number)` once all labels are known;
+//! unknown labels become "??" like in LaTeX
+static void patchReferences(std::string& output, const emitState& state,
+                            const std::function<std::string(const std::string& key, const std::string& number)>& link) {
+    if (output.find(REF_MARK) == std::string::npos) return;
+    std::string patched;
+    patched.reserve(output.size());
+    size_t pos = 0;
+    while (true) {
+        size_t start = output.find(REF_MARK, pos);
+        size_t end = start == std::string::npos ? start : output.find(REF_MARK, start + 1);
+        if (end == std::string::npos) break;
+        patched.append(output, pos, start - pos);
+        std::string key = output.substr(start + 1, end - start - 1);
+        auto label = state.labels.find(key);
+        patched += label == state.labels.end() ? "??" : link(key, label->second);
+        pos = end + 1;
+    }
+    patched.append(output, pos, std::string::npos);
+    output.swap(patched);
+}
+
+static bool isList(const ASTNode* node) {
+    return node && (node->node_type == ITEMIZE_H || node->node_type == ENUMERATE_H);
+}
+
+//! File being written: the current chunk in split mode, "" (the one output file) otherwise
+const std::string& markdownEmitter::currentFile() const {
+    static const std::string single;
+    return files.empty() ? single : files.back().file;
+}
+
+//! Markdown link to a label from a place in file `from`; a label in another file of a split document is linked
+//! through that file
+std::string markdownEmitter::referenceLink(const std::string& key, const std::string& number, const std::string& from) const {
+    auto file = labelFiles.find(key);
+    std::string target = file == labelFiles.end() || file->second == from ? "" : file->second;
+    return "[" + (number.empty() ? key : number) + "](" + target + "#" + key + ")";
+}
+
+void markdownEmitter::beginDocument() {
+    result.clear();
+    contexts.clear();
+    lists.clear();
+    tables.clear();
+    skipped = 0;
+    files.clear();
+    fileStarts.clear();
+    labelFiles.clear();
+    headingList.clear();
+    cited.clear();
+    if (split) {
+        files.push_back({"index.md", ""});
+        fileStarts.push_back(0);
+    }
+}
+
+//! Writes what the converter writes before the children of `node`. Nodes whose children the converter does not
+//! render (e.g., figures, which read their caption and label themselves) set `skipped` for their subtree.
+void markdownEmitter::enter(const ASTNode* node, const emitState& state) {
+    if (split && node->node_type == LABEL_H) labelFiles[node->data] = currentFile();
+    if (skipped) {
+        skipped++;
+        return;
+    }
+    const ASTNode* parent = state.parent();
+    const ASTNode* grandparent = state.parents.size() >= 2 ? state.parents[state.parents.size() - 2] : nullptr;
+    EscapeContext context = contexts.empty() ? ESCAPE_PARAGRAPH : contexts.back();
+    int type = node->node_type;
+
+    //! Lists: the first item holds the text of the first item followed by the other items, one line each;
+    //! any other item renders only its text
+    if (isList(parent) && node != parent->children[0]) {
+        skipped = 1;
+        return;
+    }
+    if (parent && parent->node_type == ITEM_H) {
+        if (isList(grandparent)) {
+            std::string marker(lists.size() - 1, '\t');
+            result += marker + (grandparent->node_type == ITEMIZE_H ? "-" : "1.");
+        } else if (node != parent->children[0]) {
+            skipped = 1;
+            return;
+        }
+    }
+    //! Tables: rows hold a list of cells, written " | cell | cell" with one line per row
+    bool inRow = parent && (parent->node_type == TABULAR_H || parent->node_type == ROW_H);
+    bool inCellList = parent && parent->node_type == CELL_H && grandparent && grandparent->node_type == ROW_H;
+    if ((inRow && type != ROW_H && type != CELL_H) || (inCellList && type != CELL_H)) {
+        skipped = 1;
+        return;
+    }
+    if (parent && (parent->node_type == STRING_H || parent->node_type == PAR_H)) result += " ";
+
+    switch (type) {
+        case STRING_H:
+            appendEscaped(result, node->data.data(), node->data.size(), context);
+            return;
+        case SECTION_H:
+        case SUBSECTION_H:
+        case SUBSUBSECTION_H:
+            //! In split mode, every top-level section starts a file
+            if (split && type == SECTION_H && parent && parent->node_type == DOCUMENT_H) {
+                files.push_back({converter::chunkFile(static_cast<int>(files.size()), node->data), ""});
+                fileStarts.push_back(result.size());
+            }
+            headingList.push_back({type == SECTION_H ? 1 : type == SUBSECTION_H ? 2 : 3, state.number, node->data, currentFile()});
+            result += C.getMapping(type) + " " + state.number + " ";
+            appendEscaped(result, node->data.data(), node->data.size(), ESCAPE_HEADING);
+            result += "\n\n";
+            return;
+        case ITEMIZE_H:
+        case ENUMERATE_H:
+            if (node->children.empty()) {  //! A list skipped after a syntax error has no items
+                skipped = 1;
+                return;
+            }
+            lists.push_back(result.size());
+            contexts.push_back(ESCAPE_LIST_ITEM);
+            result += "\n";
+            return;
+        case TABULAR_H:
+            if (node->children.empty()) {  //! A table skipped after a syntax error has no rows
+                skipped = 1;
+                return;
+            }
+            tables.push_back({result.size(), 0, 0});
+            contexts.push_back(ESCAPE_TABLE_CELL);
+            return;
+        case CELL_H:
+            if (parent && parent->node_type == ROW_H) result += " | ";
+            return;
+        case PAR_H:
+            result += "\n\n";
+            return;
+        case REF_H: {
+            auto label = state.labels.find(node->data);
+            if (label == state.labels.end()) result += REF_MARK + node->data + REF_MARK;
+            else result += referenceLink(node->data, label->second, currentFile());
+            break;
+        }
+        case CITE_H: {
+            //! The references section is in the index file of a split document
+            std::string file = files.size() > 1 ? files[0].file : "";
+            result += "[";
+            bool first = true;
+            for (auto& key : splitCitationKeys(node->data)) {
+                if (!first) result += ", ";
+                result += "[" + toString(state.citationNumbers.at(key)) + "](" + file + "#ref-" + key + ")";
+                first = false;
+            }
+            if (!node->attributes.empty()) {
+                result += ", ";
+                appendEscaped(result, node->attributes.data(), node->attributes.size(), context);
+            }
+            result += "] ";
+            break;
+        }
+        case LABEL_H:
+            result += "<a id=\"" + node->data + "\"></a>\n\n";
+            break;
+        case FIGURE_H: {
+            std::string anchors;
+            std::string figure = C.getMapping(FIGURE_H) + "(" + node->data + ")";
+            for (auto child : node->children) {
+                if (child->node_type == CAPTION_H) figure += " " + C.getMapping(CAPTION_H) + " \"" + child->data + "\"";
+                else if (child->node_type == LABEL_H) anchors += "<a id=\"" + child->data + "\"></a>\n\n";
+            }
+            result += anchors + figure + "\n\n";
+            break;
+        }
+        case MATH_H:
+        case DISPLAY_MATH_H:
+            C.convertMath(result, const_cast<ASTNode*>(node), context);
+            break;
+        case TEXTBF_H:
+        case TEXTIT_H:
+            result += C.getMapping(type);
+            appendEscaped(result, node->data.data(), node->data.size(), context);
+            result += C.getMapping(type) + " ";
+            break;
+        case TITLE_H:
+            if (node->data.empty()) break;
+            result += C.getMapping(type) + " ";
+            appendEscaped(result, node->data.data(), node->data.size(), ESCAPE_HEADING);
+            result += "\n\n";
+            break;
+        case DATE_H:
+            if (!node->data.empty()) result += C.getMapping(type) + node->data + "\n\n";
+            break;
+        case VERBATIM_H:
+            result += "\n\n" + C.getMapping(type) + "\n" + node->data + "\n" + C.getMapping(type) + "\n\n";
+            break;
+        case HRULE_H:
+            result += "\n\n---\n\n";
+            break;
+        case HREF_H: {
+            size_t hash = node->data.find('#');
+            std::string link = node->data.substr(0, hash);
+            std::string label;
+            if (hash != std::string::npos) {
+                for (size_t i = hash + 1; i < node->data.size(); i++) {
+                    if (node->data[i] != '#') label += node->data[i];
+                }
+            }
+            result += "[" + label + "](" + link + ") \n";
+            break;
+        }
+        default:
+            return;  //! Other nodes (documents, items, rows, text runs) are only their children
+    }
+    skipped = 1;  //! The node was written as a whole
+}
+
+//! Ends the node entered last; the end of a list item is written even if the item's text was written as a whole
+void markdownEmitter::leave(const ASTNode* node, const emitState& state) {
+    if (skipped > 1) {  //! Inside a subtree that was written, or dropped, as a whole
+        skipped--;
+        return;
+    }
+    bool whole = skipped == 1;
+    skipped = 0;
+    const ASTNode* parent = state.parent();
+    const ASTNode* grandparent = state.parents.size() >= 2 ? state.parents[state.parents.size() - 2] : nullptr;
+    if (!whole) finish(node, parent);
+    if (parent && parent->node_type == ITEM_H && isList(grandparent)) {
+        result += "\n";  //! The end of a list item
+    }
+}
+
+//! Writes what the converter writes after the children of `node`, and finishes lists and tables
+void markdownEmitter::finish(const ASTNode* node, const ASTNode* parent) {
+    switch (node->node_type) {
+        case SECTION_H:
+        case SUBSECTION_H:
+        case SUBSUBSECTION_H:
+            result += "\n\n";
+            break;
+        case ITEMIZE_H:
+        case ENUMERATE_H: {
+            size_t start = lists.back();
+            std::string list = converter::cleanListMarkers(result.substr(start) + "\n");
+            result.resize(start);
+            result += list;
+            lists.pop_back();
+            contexts.pop_back();
+            break;
+        }
+        case TABULAR_H:
+            converter::insertHeaderSeparator(result, tables.back().start, tables.back().columns);
+            result += "\n\n";
+            tables.pop_back();
+            contexts.pop_back();
+            break;
+        case CELL_H:
+            if (tables.empty()) break;
+            if (parent && parent->node_type == ROW_H) {
+                result += "\n";  //! The end of a row
+                tables.back().rows++;
+            } else if (parent && parent->node_type == CELL_H) {
+                result += " | ";
+                if (tables.back().rows == 0) tables.back().columns++;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+//! Appends the references section, or in split mode cuts the output into its files (the converter writes the
+//! references into the index), and patches forward references
+void markdownEmitter::endDocument(const emitState& state) {
+    cited = state.citations;
+    if (!split) {
+        result += C.referencesSection(state.citations);
+        patchReferences(result, state, [this](const std::string& key, const std::string& number) {
+            return referenceLink(key, number, "");
+        });
+        return;
+    }
+    fileStarts.push_back(result.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        files[i].markdown = result.substr(fileStarts[i], fileStarts[i + 1] - fileStarts[i]);
+        const std::string& from = files[i].file;
+        patchReferences(files[i].markdown, state, [this, &from](const std::string& key, const std::string& number) {
+            return referenceLink(key, number, from);
+        });
+    }
+    result.clear();
+}
+
+//! Appends `text` with the characters that are special in HTML replaced by entities; clean runs are copied in bulk
+static void appendHtml(std::string& out, const std::string& text) {
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        const char* entity;
+        switch (text[i]) {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '"': entity = "&quot;"; break;
+            default: continue;
+        }
+        out.append(text, start, i - start);
+        out += entity;
+        start = i + 1;
+    }
+    out.append(text, start, std::string::npos);
+}
+
+//! HTML link to a label, showing its number
+static std::string htmlReferenceLink(const std::string& key, const std::string& number) {
+    std::string link = "<a href=\"#";
+    appendHtml(link, key);
+    return link + "\">" + number + "</a>";
+}
+
+static bool isBlockText(int type) {
+    return type == STRING_H || type == TEXT_H || type == PAR_H;
+}
+
+void htmlEmitter::beginDocument() {
+    result = "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n</head>\n<body>\n";
+    inParagraph = false;
+}
+
+void htmlEmitter::enter(const ASTNode* node, const emitState& state) {
+    const ASTNode* parent = state.parent();
+    int parentType = parent ? parent->node_type : AST_H;
+    //! Text directly in the document is a paragraph
+    if (isBlockText(node->node_type) && parentType == DOCUMENT_H) {
+        result += "<p>";
+        inParagraph = true;
+        if (node->node_type == PAR_H) return;
+    }
+    switch (node->node_type) {
+        case TITLE_H:
+            if (!node->data.empty()) { result += "<h1>"; appendHtml(result, node->data); result += "</h1>\n"; }
+            break;
+        case DATE_H:
+            if (!node->data.empty()) { result += "<p class=\"date\">"; appendHtml(result, node->data); result += "</p>\n"; }
+            break;
+        case SECTION_H:
+        case SUBSECTION_H:
+        case SUBSUBSECTION_H: {
+            std::string tag = node->node_type == SECTION_H ? "h2" : node->node_type == SUBSECTION_H ? "h3" : "h4";
+            result += "<" + tag + ">" + state.number + " ";
+            appendHtml(result, node->data);
+            result += "</" + tag + ">\n";
+            break;
+        }
+        case STRING_H:
+            appendHtml(result, node->data);
+            result += " ";
+            break;
+        case TEXTBF_H:
+            result += "<strong>"; appendHtml(result, node->data); result += "</strong> ";
+            break;
+        case TEXTIT_H:
+            result += "<em>"; appendHtml(result, node->data); result += "</em> ";
+            break;
+        case PAR_H:
+            result += inParagraph ? "</p>\n<p>" : "<br>\n";
+            break;
+        case ITEMIZE_H: result += "<ul>\n"; break;
+        case ENUMERATE_H: result += "<ol>\n"; break;
+        //! Following items of a list are stored as children of its first item
+        case ITEM_H: result += parentType == ITEM_H ? "</li>\n<li>" : "<li>"; break;
+        case TABULAR_H: result += "<table>\n"; break;
+        //! Following rows of a table are stored as children of its first row
+        case ROW_H: result += parentType == ROW_H ? "</tr>\n<tr>" : "<tr>"; break;
+        case CELL_H:
+            if (parentType == CELL_H) result += "<td>";  //! The outer CELL_H only groups the cells of a row
+            break;
+        case VERBATIM_H:
+            result += "<pre><code>"; appendHtml(result, node->data); result += "</code></pre>\n";
+            break;
+        case HRULE_H: result += "<hr>\n"; break;
+        case HREF_H: {
+            size_t hash = node->data.find('#');
+            result += "<a href=\"";
+            appendHtml(result, node->data.substr(0, hash));
+            result += "\">";
+            appendHtml(result, hash == std::string::npos ? "" : node->data.substr(hash + 1));
+            result += "</a> ";
+            break;
+        }
+        case MATH_H:
+            result += "<span class=\"math\">\\(";
+            appendHtml(result, std::string(node->span.ptr ? node->span.ptr : "", node->span.len));
+            result += "\\)</span> ";
+            break;
+        case DISPLAY_MATH_H:
+            result += "<div class=\"math\">\\[";
+            appendHtml(result, std::string(node->span.ptr ? node->span.ptr : "", node->span.len));
+            result += "\\]</div>\n";
+            break;
+        case FIGURE_H:
+            result += "<figure>\n<img src=\"";
+            appendHtml(result, node->data);
+            result += "\">\n";
+            break;
+        case CAPTION_H:
+            result += "<figcaption>"; appendHtml(result, node->data); result += "</figcaption>\n";
+            break;
+        case LABEL_H:
+            result += "<a id=\""; appendHtml(result, node->data); result += "\"></a>\n";
+            break;
+        case REF_H: {
+            auto label = state.labels.find(node->data);
+            if (label == state.labels.end()) result += REF_MARK + node->data + REF_MARK;
+            else result += htmlReferenceLink(node->data, label->second);
+            result += " ";
+            break;
+        }
+        case CITE_H: {
+            result += "[";
+            bool first = true;
+            for (auto& key : splitCitationKeys(node->data)) {
+                if (!first) result += ", ";
+                result += "<a href=\"#ref-"; appendHtml(result, key); result += "\">";
+                result += toString(state.citationNumbers.at(key)) + "</a>";
+                first = false;
+            }
+            if (!node->attributes.empty()) {
+                result += ", ";
+                appendHtml(result, node->attributes);
+            }
+            result += "] ";
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void htmlEmitter::leave(const ASTNode* node, const emitState& state) {
+    const ASTNode* parent = state.parent();
+    int parentType = parent ? parent->node_type : AST_H;
+    switch (node->node_type) {
+        case ITEMIZE_H: result += "</ul>\n"; break;
+        case ENUMERATE_H: result += "</ol>\n"; break;
+        case ITEM_H: if (parentType != ITEM_H) result += "</li>\n"; break;
+        case TABULAR_H: result += "</table>\n"; break;
+        case ROW_H: if (parentType != ROW_H) result += "</tr>\n"; break;
+        case CELL_H: if (parentType == CELL_H) result += "</td>"; break;
+        case FIGURE_H: result += "</figure>\n"; break;
+        default: break;
+    }
+    if (isBlockText(node->node_type) && parentType == DOCUMENT_H) {
+        result += "</p>\n";
+        inParagraph = false;
+    }
+}
+
+//! Lists the cited entries, then patches forward references now that every label is known;
+//! unknown labels become "??" like in LaTeX
+void htmlEmitter::endDocument(const emitState& state) {
+    if (!state.citations.empty()) {
+        result += "<h2>References</h2>\n<ol>\n";
+        bibEntry entry;
+        for (auto& key : state.citations) {
+            result += "<li id=\"ref-"; appendHtml(result, key); result += "\">";
+            if (!bib || !bib->lookup(key, entry)) {
+                appendHtml(result, key);
+            } else {
+                std::string author = entry.field("author"), title = entry.field("title"), venue = entry.venue(), year = entry.field("year");
+                if (!author.empty()) { appendHtml(result, author); result += ". "; }
+                if (!title.empty()) { result += "<em>"; appendHtml(result, title); result += "</em>. "; }
+                if (!venue.empty()) { appendHtml(result, venue); result += year.empty() ? ". " : ", "; }
+                if (!year.empty()) { appendHtml(result, year); result += "."; }
+                while (result.back() == ' ') result.pop_back();
+            }
+            result += "</li>\n";
+        }
+        result += "</ol>\n";
+    }
+    result += "</body>\n</html>\n";
+    patchReferences(result, state, htmlReferenceLink);
+}
+
+//! Appends `text` as a JSON string literal; UTF-8 is kept as is, control characters are escaped
+static void appendJson(std::string& out, const char* text, size_t len) {
+    out += '"';
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char ch = text[i];
+        if (ch >= 0x20 && ch != '"' && ch != '\\') continue;
+        out.append(text + start, i - start);
+        start = i + 1;
+        switch (ch) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+                out += escaped;
+            }
+        }
+    }
+    out.append(text + start, len - start);
+    out += '"';
+}
+
+void jsonEmitter::beginDocument() {
+    result.clear();
+    firstChild.clear();
+}
+
+void jsonEmitter::enter(const ASTNode* node, const emitState& state) {
+    if (!firstChild.empty()) {
+        if (!firstChild.back()) result += ",";
+        firstChild.back() = false;
+    }
+    result += "{\"type\":";
+    std::string type = nodeTypeToString(node->node_type);
+    appendJson(result, type.data(), type.size());
+    if (!state.number.empty()) {
+        result += ",\"number\":";
+        appendJson(result, state.number.data(), state.number.size());
+    }
+    if (node->node_type == MATH_H || node->node_type == DISPLAY_MATH_H) {
+        result += ",\"text\":";
+        appendJson(result, node->span.ptr ? node->span.ptr : "", node->span.len);
+    } else if (!node->data.empty()) {
+        result += ",\"text\":";
+        appendJson(result, node->data.data(), node->data.size());
+    }
+    if (node->node_type == CITE_H && !node->attributes.empty()) {
+        result += ",\"note\":";
+        appendJson(result, node->attributes.data(), node->attributes.size());
+    }
+    if (!node->children.empty()) result += ",\"children\":[";
+    firstChild.push_back(true);
+}
+
+void jsonEmitter::leave(const ASTNode* node, const emitState&) {
+    firstChild.pop_back();
+    result += node->children.empty() ? "}" : "]}";
+}
+
+void jsonEmitter::endDocument(const emitState&) {
+    if (result.empty()) result = "null";
+    result += "\n";
+}
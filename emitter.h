@@ -0,0 +1,120 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include "ast.h"
+#include "converter.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//! Traversal state computed once by emitDocument and shared by every backend
+struct emitState {
+    std::string number;                     //! Number of the section or figure being entered (empty for other nodes)
+    std::unordered_map<std::string, std::string> labels;  //! Label key -> number, complete once the walk has ended
+    std::vector<const ASTNode*> parents;    //! Ancestors of the node being visited, innermost last
+    std::vector<std::string> citations;     //! Cited keys in order of first citation, up to the node being visited
+    std::unordered_map<std::string, int> citationNumbers;  //! Cited key -> number shown in the text
+
+    //! Direct parent of the node being visited, or nullptr for the root
+    const ASTNode* parent() const { return parents.empty() ? nullptr : parents.back(); }
+};
+
+//! An output format driven by emitDocument. The walk visits every node once in document order,
+//! calling enter before a node's children and leave after them; each backend writes into its own output.
+class emitter {
+public:
+    virtual ~emitter() {}
+
+    virtual void beginDocument() {}
+    virtual void enter(const ASTNode* node, const emitState& state) = 0;
+    virtual void leave(const ASTNode* node, const emitState& state) = 0;
+    //! Called once the walk is done; all labels are known, so forward references can be patched here
+    virtual void endDocument(const emitState&) {}
+
+    //! The produced document
+    virtual const std::string& output() const = 0;
+    //! File extension of the format, without the dot (e.g., "html")
+    virtual const char* extension() const = 0;
+};
+
+//! Markdown backend: writes each node as the walk reaches it, with the numbers, labels and citations of the walk.
+//! The converter supplies the markup, math and references. In split mode, each top-level section starts a new file
+//! (see converter::splitSections); references and citations across files link through the file they point into.
+class markdownEmitter : public emitter {
+    //! A table being written: where it starts in the output, the rows written so far and the cells of the first row
+    struct openTable {
+        size_t start;
+        int rows;
+        int columns;
+    };
+
+    converter& C;
+    bool split;
+    std::string result;
+    std::vector<EscapeContext> contexts;  //! Escape context of the open lists and tables, innermost last
+    std::vector<size_t> lists;            //! Where each open list starts in the output, innermost last
+    std::vector<openTable> tables;
+    int skipped;                          //! Depth inside a subtree written or dropped as a whole (0: none)
+    std::vector<sectionChunk> files;      //! Split mode: the files, with their text filled in by endDocument
+    std::vector<size_t> fileStarts;       //! Split mode: where each file starts in the output
+    std::unordered_map<std::string, std::string> labelFiles;  //! Split mode: label key -> file it is in
+    std::vector<headingEntry> headingList;
+    std::vector<std::string> cited;
+
+    const std::string& currentFile() const;
+    std::string referenceLink(const std::string& key, const std::string& number, const std::string& from) const;
+    void finish(const ASTNode* node, const ASTNode* parent);
+public:
+    explicit markdownEmitter(converter& C, bool split = false) : C(C), split(split), skipped(0) {}
+    void beginDocument();
+    void enter(const ASTNode* node, const emitState& state);
+    void leave(const ASTNode* node, const emitState& state);
+    void endDocument(const emitState& state);
+    //! The document; empty in split mode, where it is in chunks()
+    const std::string& output() const { return result; }
+    const char* extension() const { return "md"; }
+
+    //! Split mode: the preamble (index file) followed by one file per top-level section
+    const std::vector<sectionChunk>& chunks() const { return files; }
+    //! Headings in document order, for the table of contents
+    const std::vector<headingEntry>& headings() const { return headingList; }
+    //! Cited keys in order of first citation
+    const std::vector<std::string>& citations() const { return cited; }
+};
+
+//! HTML backend: a standalone HTML5 page
+class htmlEmitter : public emitter {
+    std::string result;
+    bool inParagraph;          //! A <p> opened for a block of text is still open
+    const bibDatabase* bib;    //! Entries listed under References (nullptr: only the keys)
+public:
+    explicit htmlEmitter(const bibDatabase* bib = nullptr) : inParagraph(false), bib(bib) {}
+    void beginDocument();
+    void enter(const ASTNode* node, const emitState& state);
+    void leave(const ASTNode* node, const emitState& state);
+    void endDocument(const emitState& state);
+    const std::string& output() const { return result; }
+    const char* extension() const { return "html"; }
+};
+
+//! JSON backend: the AST as nested objects ({"type", "number", "text", "children"}), e.g. for search indexing
+class jsonEmitter : public emitter {
+    std::string result;
+    std::vector<bool> firstChild;  //! Per open node: no child has been written yet
+public:
+    void beginDocument();
+    void enter(const ASTNode* node, const emitState& state);
+    void leave(const ASTNode* node, const emitState& state);
+    void endDocument(const emitState& state);
+    const std::string& output() const { return result; }
+    const char* extension() const { return "json"; }
+};
+
+//! Walks the AST once and drives every backend in `backends` from the same traversal.
+//! Throws budgetExceeded if the document runs over the budget of the current thread (budget.h).
+void emitDocument(ASTNode* root, const std::vector<emitter*>& backends);
+
+//! `path` with its file extension replaced by `extension` (e.g., out.md -> out.html)
+std::string replaceExtension(const std::string& path, const char* extension);
+
+#endif //! EMITTER_H
@@ -0,0 +1,147 @@
+#include "escape.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//! Every context escapes the contiguous range [ \ ] ^ _ ` (0x5B-0x60) plus three single bytes;
+//! checking the range takes two SIMD operations instead of one compare per byte value
+const unsigned char RANGE_LOW = '[';
+const unsigned char RANGE_HIGH = '`';
+
+//! Clean text is scanned and copied this many bytes at a time, so the copy reads what the scan left in the cache
+const size_t WINDOW = 8192;
+
+//! True if `c` is special in the context whose single bytes are A, B and C
+template <char A, char B, char C>
+static inline bool isSpecial(char c) {
+    return static_cast<unsigned char>(c - RANGE_LOW) <= RANGE_HIGH - RANGE_LOW || c == A || c == B || c == C;
+}
+
+//! Offset of the first byte of text[0, len) that is special in the context whose single bytes are A, B and C,
+//! or len if there is none. The bytes are template arguments so that every compare vector is a constant the
+//! compiler keeps in a register; clean text is skipped 64 bytes per iteration and the hit located 16 at a time.
+template <char A, char B, char C>
+static size_t findSpecial(const char* text, size_t len) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    //! Shift the range to the bottom of the signed byte range, then one signed compare tests membership
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80 - RANGE_LOW));
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(0x80 + RANGE_HIGH - RANGE_LOW + 1));
+    const __m128i a = _mm_set1_epi8(A), b = _mm_set1_epi8(B), c = _mm_set1_epi8(C);
+    auto match = [&](size_t at) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + at));
+        __m128i hits = _mm_cmplt_epi8(_mm_add_epi8(block, bias), limit);
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, a));
+        return _mm_or_si128(hits, _mm_or_si128(_mm_cmpeq_epi8(block, b), _mm_cmpeq_epi8(block, c)));
+    };
+    for (; i + 64 <= len; i += 64) {
+        __m128i hits = _mm_or_si128(_mm_or_si128(match(i), match(i + 16)), _mm_or_si128(match(i + 32), match(i + 48)));
+        if (_mm_movemask_epi8(hits) != 0) break;
+    }
+    for (; i + 16 <= len; i += 16) {
+        int mask = _mm_movemask_epi8(match(i));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t low = vdupq_n_u8(RANGE_LOW), width = vdupq_n_u8(RANGE_HIGH - RANGE_LOW);
+    const uint8x16_t a = vdupq_n_u8(A), b = vdupq_n_u8(B), c = vdupq_n_u8(C);
+    auto match = [&](size_t at) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(text + at));
+        uint8x16_t hits = vcleq_u8(vsubq_u8(block, low), width);
+        hits = vorrq_u8(hits, vceqq_u8(block, a));
+        return vorrq_u8(hits, vorrq_u8(vceqq_u8(block, b), vceqq_u8(block, c)));
+    };
+    for (; i + 64 <= len; i += 64) {
+        uint8x16_t hits = vorrq_u8(vorrq_u8(match(i), match(i + 16)), vorrq_u8(match(i + 32), match(i + 48)));
+        if (vmaxvq_u8(hits) != 0) break;
+    }
+    for (; i + 16 <= len; i += 16) {
+        if (vmaxvq_u8(match(i)) != 0) break;
+    }
+#endif
+    while (i < len && !isSpecial<A, B, C>(text[i])) i++;
+    return i;
+}
+
+//! True if text appended to `out` starts a line: `out` is empty or ends in a line break and blanks, or in a list
+//! marker ("-" or "1." after the tabs that nest it) that opens a line, since the text then starts the item's line
+static bool atLineStart(const std::string& out) {
+    size_t i = out.find_last_not_of(" \t");
+    if (i == std::string::npos || out[i] == '\n') return true;
+    if (out[i] == '-') i--;
+    else if (out[i] == '.' && i > 0 && out[i - 1] == '1') i -= 2;
+    else return false;
+    while (i != std::string::npos && out[i] == '\t') i--;
+    return i == std::string::npos || out[i] == '\n';
+}
+
+//! Escapes what would make the line starting at text[pos] a block: a heading (#), quote (>), list item (- + 1.)
+//! or thematic break (---). Copies the blanks and the marker and returns the position after them.
+static size_t escapeLineStart(std::string& out, const char* text, size_t pos, size_t len) {
+    size_t start = pos;
+    while (pos < len && (text[pos] == ' ' || text[pos] == '\t')) pos++;
+    out.append(text + start, pos - start);
+    if (pos == len) return pos;
+    char ch = text[pos];
+    if (ch == '#' || ch == '>' || ch == '-' || ch == '+') {
+        out += '\\';
+        out += ch;
+        return pos + 1;
+    }
+    //! An ordered list marker is 1-9 digits and '.' or ')' followed by a blank or the end of the line
+    size_t digits = pos;
+    while (digits < len && digits - pos < 10 && text[digits] >= '0' && text[digits] <= '9') digits++;
+    if (digits > pos && digits - pos <= 9 && digits < len && (text[digits] == '.' || text[digits] == ')') &&
+        (digits + 1 == len || text[digits + 1] == ' ' || text[digits + 1] == '\t' || text[digits + 1] == '\n')) {
+        out.append(text + pos, digits - pos);
+        out += '\\';
+        out += text[digits];
+        return digits + 1;
+    }
+    return pos;
+}
+
+//! Appends `text` to `out` for the context whose single bytes are A, B and C; a context with '\n' among them
+//! escapes block markers at the start of each line
+template <char A, char B, char C>
+static void appendIn(std::string& out, const char* text, size_t len) {
+    const bool blockMarkers = A == '\n' || B == '\n' || C == '\n';
+    size_t pos = blockMarkers && atLineStart(out) ? escapeLineStart(out, text, 0, len) : 0;
+    while (pos < len) {
+        size_t window = len - pos < WINDOW ? len - pos : WINDOW;
+        size_t hit = pos + findSpecial<A, B, C>(text + pos, window);
+        out.append(text + pos, hit - pos);  //! Clean run, copied in one go
+        if (hit == pos + window) {
+            pos = hit;
+            continue;
+        }
+        if (blockMarkers && text[hit] == '\n') {
+            out += '\n';
+            pos = escapeLineStart(out, text, hit + 1, len);
+            continue;
+        }
+        out += '\\';
+        out += text[hit];
+        pos = hit + 1;
+    }
+}
+
+//! Appends `text` to `out`, escaping Markdown specials for `context`
+void appendEscaped(std::string& out, const char* text, size_t len, EscapeContext context) {
+    switch (context) {
+        case ESCAPE_HEADING: return appendIn<'*', '<', '#'>(out, text, len);
+        case ESCAPE_TABLE_CELL: return appendIn<'*', '<', '|'>(out, text, len);
+        default: return appendIn<'*', '<', '\n'>(out, text, len);
+    }
+}
+
+//! Returns `text` escaped for `context`
+std::string escapeMarkdown(const std::string& text, EscapeContext context) {
+    std::string out;
+    out.reserve(text.size() + 8);
+    appendEscaped(out, text.data(), text.size(), context);
+    return out;
+}
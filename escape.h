@@ -0,0 +1,22 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include <string>
+
+//! Where escaped text ends up in the Markdown output; each context has its own set of special bytes
+enum EscapeContext {
+    ESCAPE_PARAGRAPH,     //! Running text: \ ` * _ [ ] ^ <, and # > - + 1. as the first non-blank of a line
+    ESCAPE_HEADING,       //! Section titles: \ ` * _ [ ] ^ < #
+    ESCAPE_LIST_ITEM,     //! List item text: same set as paragraphs
+    ESCAPE_TABLE_CELL     //! Table cells: \ ` * _ [ ] ^ < |
+};
+
+//! Appends `text` to `out`, backslash-escaping the bytes that are special in Markdown in `context`.
+//! Escapable bytes are located 64 at a time (four SSE2/NEON blocks) and the clean runs between them are copied in bulk.
+//! Block markers are escaped where `text` starts a line of `out`, so callers append straight into their output.
+void appendEscaped(std::string& out, const char* text, size_t len, EscapeContext context);
+
+//! Returns `text` escaped for `context`, as if it started a line
+std::string escapeMarkdown(const std::string& text, EscapeContext context);
+
+#endif //! ESCAPE_H
@@ -0,0 +1,350 @@
+#include "macro.h"
+#include "budget.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static const int MAX_DEPTH = 64;  //! Nesting limit for expansions; deeper means a macro (indirectly) expands to itself
+static const size_t MAX_GROWTH = 64;         //! Size limit of the expansion, as a multiple of the source length
+static const size_t MIN_LIMIT = 64 * 1024;   //! Size limit for short sources, which MAX_GROWTH would make too tight
+
+static const char* DEFINITION_COMMANDS[] = { "newcommand", "renewcommand", "providecommand", "def" };
+
+static bool isLetter(char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+static const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+static const char* skipSpace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    return p;
+}
+
+//! End of the group that opens at `p` with `open`, just past its matching `close`; nullptr if unbalanced.
+//! Escaped delimiters (\{, \}) do not count.
+static const char* matchGroup(const char* p, const char* end, char open, char close) {
+    int depth = 0;
+    for (; p < end; p++) {
+        if (*p == '\\') {
+            p++;
+            continue;
+        }
+        if (*p == open) depth++;
+        else if (*p == close && --depth == 0) return p + 1;
+    }
+    return nullptr;
+}
+
+//! True if `data` may define a macro; documents without definitions skip expansion entirely
+bool macroExpander::hasDefinitions(const char* data, size_t len) {
+    const char* end = data + len;
+    for (const char* p = data; (p = static_cast<const char*>(memchr(p, '\\', end - p))) != nullptr; p++) {
+        for (const char* command : DEFINITION_COMMANDS) {
+            size_t n = strlen(command);
+            if (static_cast<size_t>(end - p - 1) >= n && memcmp(p + 1, command, n) == 0 &&
+                (p + 1 + n == end || !isLetter(p[1 + n]))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//! Expands every macro use in `data`, applying definitions in document order
+std::string macroExpander::expand(const char* data, size_t len) {
+    std::string out;
+    out.reserve(len + len / 8);
+    expansions.clear();
+    limit = std::max(len * MAX_GROWTH, MIN_LIMIT);
+    stopped = false;
+    expandInto(out, data, data + len, 0);
+    return out;
+}
+
+//! Outside of top-level macro uses, the expanded text has the same line breaks as the source (definitions keep
+//! theirs), so lines there map one to one; the line holding the end of a use maps to the line the use ends on
+std::vector<int> macroExpander::sourceLines(const std::string& expanded) const {
+    std::vector<int> lines(1, 1);
+    int line = 1;
+    size_t pos = 0;
+    for (const expansion& use : expansions) {
+        for (; pos < use.outBegin; pos++) {
+            if (expanded[pos] == '\n') lines.push_back(++line);
+        }
+        for (; pos < use.outEnd; pos++) {
+            if (expanded[pos] == '\n') lines.push_back(line);
+        }
+        line += static_cast<int>(std::count(use.sourceBegin, use.sourceEnd, '\n'));
+        lines.back() = line;
+    }
+    for (; pos < expanded.size(); pos++) {
+        if (expanded[pos] == '\n') lines.push_back(++line);
+    }
+    return lines;
+}
+
+void macroExpander::expandInto(std::string& out, const char* p, const char* end, int depth) {
+    static const char VERBATIM_BEGIN[] = "\\begin{verbatim}";
+    static const char VERBATIM_END[] = "\\end{verbatim}";
+    while (p < end) {
+        //! Plain text up to the next command or comment is copied in one go
+        const char* run = p;
+        while (p < end && *p != '\\' && *p != '%') p++;
+        out.append(run, p - run);
+        if (p == end) break;
+
+        if (*p == '%') {
+            const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+            const char* next = eol ? eol + 1 : end;
+            out.append(p, next - p);
+            p = next;
+            continue;
+        }
+
+        const char* nameEnd = p + 1;
+        while (nameEnd < end && isLetter(*nameEnd)) nameEnd++;
+        if (nameEnd == p + 1) {
+            //! Control symbol such as \\ or \%: copied as is
+            const char* next = p + 2 <= end ? p + 2 : end;
+            out.append(p, next - p);
+            p = next;
+            continue;
+        }
+        name.assign(p + 1, nameEnd);
+
+        if (name == "begin" && static_cast<size_t>(end - p) >= sizeof(VERBATIM_BEGIN) - 1 &&
+            memcmp(p, VERBATIM_BEGIN, sizeof(VERBATIM_BEGIN) - 1) == 0) {
+            const char* close = std::search(p, end, VERBATIM_END, VERBATIM_END + sizeof(VERBATIM_END) - 1);
+            const char* next = close == end ? end : close + sizeof(VERBATIM_END) - 1;
+            out.append(p, next - p);
+            p = next;
+            continue;
+        }
+
+        bool isDefinition = false;
+        for (const char* command : DEFINITION_COMMANDS) {
+            if (name == command) isDefinition = true;
+        }
+        if (isDefinition) {
+            std::string command = name;
+            const char* next = define(command, nameEnd, end);
+            if (next) {
+                //! The line breaks of a multi-line definition are kept, so parse errors point at the right source line
+                out.append(std::count(p, next, '\n'), '\n');
+                p = next;
+                continue;
+            }
+            problems.push_back("malformed \\" + command + " left as is");
+        } else {
+            auto found = macros.find(name);
+            if (found != macros.end()) {
+                std::string macroName = name;
+                size_t outBegin = out.size();
+                const char* next = expandUse(out, found->second, macroName, nameEnd, end, depth);
+                if (next) {
+                    if (depth == 0) expansions.push_back({outBegin, out.size(), p, next});
+                    p = next;
+                    continue;
+                }
+            }
+        }
+        out.append(p, nameEnd - p);
+        p = nameEnd;
+    }
+}
+
+//! Parses a definition following \newcommand, \renewcommand, \providecommand or \def and records it.
+//! Returns the position after the definition, or nullptr if it is malformed.
+const char* macroExpander::define(const std::string& command, const char* p, const char* end) {
+    macro m;
+    m.params = 0;
+    m.hasDefault = false;
+    std::string macroName;
+
+    if (command == "def") {
+        //! \def\name#1#2{body}: parameters are undelimited
+        p = skipSpace(p, end);
+        if (p >= end || *p != '\\') return nullptr;
+        const char* nameEnd = p + 1;
+        while (nameEnd < end && isLetter(*nameEnd)) nameEnd++;
+        if (nameEnd == p + 1) return nullptr;
+        macroName.assign(p + 1, nameEnd);
+        p = nameEnd;
+        while (p + 1 < end && *p == '#' && p[1] >= '1' && p[1] <= '9') {
+            m.params = p[1] - '0';
+            p += 2;
+        }
+    } else {
+        //! \newcommand*{\name}[params][default]{body} or \newcommand\name{body}
+        p = skipSpace(p, end);
+        if (p < end && *p == '*') p = skipSpace(p + 1, end);
+        bool braced = p < end && *p == '{';
+        if (braced) p = skipSpace(p + 1, end);
+        if (p >= end || *p != '\\') return nullptr;
+        const char* nameEnd = p + 1;
+        while (nameEnd < end && isLetter(*nameEnd)) nameEnd++;
+        if (nameEnd == p + 1) return nullptr;
+        macroName.assign(p + 1, nameEnd);
+        p = skipSpace(nameEnd, end);
+        if (braced) {
+            if (p >= end || *p != '}') return nullptr;
+            p = skipSpace(p + 1, end);
+        }
+        if (p < end && *p == '[') {
+            const char* close = matchGroup(p, end, '[', ']');
+            if (!close) return nullptr;
+            m.params = atoi(std::string(p + 1, close - 1).c_str());
+            if (m.params < 0 || m.params > 9) return nullptr;
+            p = skipSpace(close, end);
+        }
+        if (p < end && *p == '[') {
+            const char* close = matchGroup(p, end, '[', ']');
+            if (!close) return nullptr;
+            m.hasDefault = m.params > 0;
+            m.defaultArg.assign(p + 1, close - 1);
+            p = skipSpace(close, end);
+        }
+    }
+
+    p = skipSpace(p, end);
+    if (p >= end || *p != '{') return nullptr;
+    const char* close = matchGroup(p, end, '{', '}');
+    if (!close) return nullptr;
+    m.body.assign(p + 1, close - 1);
+
+    if (command == "providecommand" && macros.count(macroName)) return close;
+    macros[macroName] = m;
+    memo.clear();  //! Cached expansions may depend on the macro that was just (re)defined
+    return close;
+}
+
+//! True if `size` bytes of expansion exceed the limit; the first time, reports it and stops all further expansion
+bool macroExpander::exceedsLimit(size_t size) {
+    if (size <= limit) return false;
+    if (!stopped) {
+        problems.push_back("macro expansion exceeds " + std::to_string(limit) +
+                           " bytes, the remaining macro uses are left unexpanded");
+        stopped = true;
+    }
+    return true;
+}
+
+//! Reads the arguments of a macro use starting at `p`, appends the expansion to `out` and returns the
+//! position after the arguments; nullptr if the arguments are missing (the use is then copied as is)
+const char* macroExpander::expandUse(std::string& out, const macro& m, const std::string& macroName,
+                                     const char* p, const char* end, int depth) {
+    //! Macros that expand to several uses of each other grow exponentially within MAX_DEPTH, and the cache makes
+    //! each doubling cheap; the size limit stops them even when the budget sets no output limit
+    checkBudget();
+    checkOutput(out.size());
+    if (stopped) return nullptr;
+    if (depth >= MAX_DEPTH) {
+        problems.push_back("\\" + macroName + " is nested too deeply (recursive definition?), left unexpanded");
+        return nullptr;
+    }
+
+    if (m.params == 0) {
+        //! Like TeX, spaces after a control word are skipped; an empty group ends the name explicitly
+        p = skipBlanks(p, end);
+        if (p + 1 < end && p[0] == '{' && p[1] == '}') p += 2;
+        auto cached = memo.find(macroName);
+        if (cached != memo.end()) {
+            if (exceedsLimit(out.size() + cached->second.size())) return nullptr;
+            hits++;
+            out += cached->second;
+            return p;
+        }
+        std::string body = m.body;  //! Copied: expansion may redefine the macro
+        std::string expanded;
+        expandInto(expanded, body.data(), body.data() + body.size(), depth + 1);
+        if (exceedsLimit(out.size() + expanded.size())) return nullptr;
+        out += expanded;
+        if (depth < MAX_DEPTH - 1) memo[macroName] = expanded;
+        return p;
+    }
+
+    std::vector<std::string> args;
+    for (int i = 0; i < m.params; i++) {
+        const char* start = skipSpace(p, end);
+        if (i == 0 && m.hasDefault) {
+            if (start < end && *start == '[') {
+                const char* close = matchGroup(start, end, '[', ']');
+                if (!close) return nullptr;
+                args.push_back(std::string(start + 1, close - 1));
+                p = close;
+            } else {
+                args.push_back(m.defaultArg);
+            }
+            continue;
+        }
+        if (start >= end) {
+            problems.push_back("\\" + macroName + " is missing arguments, left unexpanded");
+            return nullptr;
+        }
+        if (*start == '{') {
+            const char* close = matchGroup(start, end, '{', '}');
+            if (!close) {
+                problems.push_back("\\" + macroName + " has an unbalanced argument, left unexpanded");
+                return nullptr;
+            }
+            args.push_back(std::string(start + 1, close - 1));
+            p = close;
+        } else if (*start == '\\') {
+            //! A single command as argument
+            const char* nameEnd = start + 1;
+            while (nameEnd < end && isLetter(*nameEnd)) nameEnd++;
+            if (nameEnd == start + 1 && nameEnd < end) nameEnd++;
+            args.push_back(std::string(start, nameEnd));
+            p = nameEnd;
+        } else {
+            args.push_back(std::string(start, 1));
+            p = start + 1;
+        }
+    }
+
+    std::string substituted;
+    substituted.reserve(m.body.size());
+    for (size_t i = 0; i < m.body.size(); i++) {
+        char ch = m.body[i];
+        if (ch == '#' && i + 1 < m.body.size()) {
+            char next = m.body[i + 1];
+            if (next >= '1' && next <= '9' && next - '1' < static_cast<int>(args.size())) {
+                substituted += args[next - '1'];
+                i++;
+                continue;
+            }
+            if (next == '#') {
+                substituted += '#';
+                i++;
+                continue;
+            }
+        }
+        substituted += ch;
+    }
+    if (exceedsLimit(out.size() + substituted.size())) return nullptr;
+    expandInto(out, substituted.data(), substituted.data() + substituted.size(), depth + 1);
+    return p;
+}
+
+//! Expands the macros of a scanner input buffer (text followed by two NULs) in place.
+//! Returns false if the document defines no macros and the buffer was left as is.
+bool expandMacros(std::vector<char>& buffer, const char* filename, std::vector<int>* sourceLines) {
+    size_t len = buffer.size() - 2;
+    if (sourceLines) sourceLines->clear();
+    if (!macroExpander::hasDefinitions(buffer.data(), len)) return false;
+    macroExpander expander;
+    std::string expanded = expander.expand(buffer.data(), len);
+    if (sourceLines) *sourceLines = expander.sourceLines(expanded);  //! Before the source buffer is overwritten
+    for (const std::string& warning : expander.warnings()) {
+        std::cerr << filename << ": " << warning << std::endl;
+    }
+    buffer.assign(expanded.begin(), expanded.end());
+    buffer.push_back('\0');
+    buffer.push_back('\0');
+    return true;
+}
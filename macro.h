@@ -0,0 +1,71 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//! Expands user-defined macros (\newcommand, \renewcommand, \providecommand, \def) in LaTeX source
+//! before it reaches the scanner, so lex.l only ever sees the commands it knows.
+//! Comments and verbatim environments are copied untouched; the definitions themselves are removed.
+class macroExpander {
+public:
+    macroExpander() : hits(0), limit(0), stopped(false) {}
+
+    //! True if `data` may define a macro; documents without definitions skip expansion entirely
+    static bool hasDefinitions(const char* data, size_t len);
+
+    //! Expands every macro use in `data`, applying definitions in document order. Once the expansion grows past a fixed
+    //! multiple of `len`, the remaining uses are left as is and a warning is added.
+    //! Throws budgetExceeded if the expansion runs over the budget of the current thread (budget.h).
+    std::string expand(const char* data, size_t len);
+
+    //! Problems found while expanding (runaway recursion or growth, missing arguments)
+    const std::vector<std::string>& warnings() const { return problems; }
+
+    //! Uses of argument-free macros that were served from the expansion cache
+    size_t cacheHits() const { return hits; }
+
+    //! Source line of each line of `expanded`, the result of the last expand(): element i is the line of the source
+    //! that expanded line i + 1 comes from. Lines added by a macro use map to the line the use starts on.
+    std::vector<int> sourceLines(const std::string& expanded) const;
+
+private:
+    struct macro {
+        int params;                 //! Number of parameters (#1 to #9)
+        bool hasDefault;            //! The first parameter is optional ([default] in \newcommand)
+        std::string defaultArg;     //! Value of the optional first parameter when it is not given
+        std::string body;           //! Replacement text
+    };
+
+    //! A top-level macro use: its expansion in the output and the text it replaced in the source
+    struct expansion {
+        size_t outBegin, outEnd;
+        const char* sourceBegin;
+        const char* sourceEnd;
+    };
+
+    std::unordered_map<std::string, macro> macros;     //! Macro name (without backslash) -> definition
+    std::unordered_map<std::string, std::string> memo; //! Fully expanded bodies of argument-free macros
+    std::vector<std::string> problems;
+    std::vector<expansion> expansions;                 //! Top-level uses in output order, for sourceLines
+    std::string name;                                  //! Scratch buffer for command names, reused across lookups
+    size_t hits;
+    size_t limit;                                      //! Size limit of the expansion of the current source
+    bool stopped;                                      //! The limit was hit; no further uses are expanded
+
+    bool exceedsLimit(size_t size);
+    void expandInto(std::string& out, const char* p, const char* end, int depth);
+    const char* define(const std::string& command, const char* p, const char* end);
+    const char* expandUse(std::string& out, const macro& m, const std::string& macroName,
+                          const char* p, const char* end, int depth);
+};
+
+//! Expands the macros of a scanner input buffer (text followed by two NULs) in place.
+//! Returns false if the document defines no macros and the buffer was left as is. If `sourceLines` is given, it
+//! receives the source line of each line of the expanded buffer (see macroExpander::sourceLines); it is left
+//! empty when the buffer was not expanded.
+bool expandMacros(std::vector<char>& buffer, const char* filename, std::vector<int>* sourceLines = nullptr);
+
+#endif //! MACRO_H
@@ -1,43 +1,180 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
 #include "ast.h"
 #include "converter.h"
+#include "profiler.h"
+#include "pipeline.h"
+#include "emitter.h"
+#include "macro.h"
+#include "budget.h"
+#include "parse.h"
 using namespace std;
 
-extern int yyparse();
-extern FILE *yyin;
-extern void yyerror(const char *s);
-extern ASTNode* root; 
-
 ASTManager astManager;
 
-void yyerror(const char *s) {
-	cout << "Parse error!  Message: " << s << endl;
-	exit(-1);
+//! Default budget of a document: only the nesting depth is limited, deep enough for any real document
+//! but far short of overflowing the converter's stack
+static resourceLimits defaultLimits() {
+	resourceLimits limits = { 0, 1000, 0, 0 };
+	return limits;
+}
+
+//! Reads a budget option (--max-nodes, --max-depth, --max-output, --max-seconds) and its value at argv[i];
+//! returns false if argv[i] is not one
+static bool parseLimit(int argc, char *argv[], int& i, resourceLimits& limits) {
+	if (i + 1 >= argc) return false;
+	if (strcmp(argv[i], "--max-nodes") == 0) limits.maxNodes = strtoull(argv[++i], nullptr, 10);
+	else if (strcmp(argv[i], "--max-depth") == 0) limits.maxDepth = strtoull(argv[++i], nullptr, 10);
+	else if (strcmp(argv[i], "--max-output") == 0) limits.maxOutputBytes = strtoull(argv[++i], nullptr, 10);
+	else if (strcmp(argv[i], "--max-seconds") == 0) limits.maxSeconds = atof(argv[++i]);
+	else return false;
+	return true;
+}
+
+//! Opens the bibliography at `path` and reports the entries it had to skip on stderr; false if it cannot be opened
+static bool openBibliography(bibDatabase& bib, const char* path) {
+	if (!bib.open(path)) {
+		cout << "Error opening bibliography: " << path << endl;
+		return false;
+	}
+	for (const string& warning : bib.warnings()) cerr << path << ": " << warning << endl;
+	return true;
+}
+
+//! Batch mode: converts many documents with the overlapped read/convert/write pipeline and
+//! prints the per-stage stall report to stderr
+int runBatch(int argc, char *argv[]) {
+	pipelineOptions options;
+	options.queueDepth = 4;
+	options.workers = max(1u, thread::hardware_concurrency());
+	options.mathTransform = false;
+	options.html = options.json = false;
+	options.bib = nullptr;
+	options.limits = defaultLimits();
+	bibDatabase bib;  //! Indexed once, then shared read-only by all workers
+	vector<string> inputs;
+	for (int i = 3; i < argc; i++) {
+		if (strcmp(argv[i], "--plain-math") == 0) options.mathTransform = true;
+		else if (strcmp(argv[i], "--html") == 0) options.html = true;
+		else if (strcmp(argv[i], "--json") == 0) options.json = true;
+		else if (strcmp(argv[i], "--queue-depth") == 0 && i + 1 < argc) options.queueDepth = max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) options.workers = max(1, atoi(argv[++i]));
+		else if (parseLimit(argc, argv, i, options.limits)) continue;
+		else if (strcmp(argv[i], "--bib") == 0 && i + 1 < argc) {
+			if (!openBibliography(bib, argv[++i])) return -1;
+			options.bib = &bib;
+		}
+		else if (strncmp(argv[i], "--", 2) == 0) {
+			cout << "Unknown option: " << argv[i] << endl;
+			return -1;
+		}
+		else inputs.push_back(argv[i]);
+	}
+
+	pipelineReport report = runPipeline(inputs, argv[2], options);
+	printPipelineReport(report, cerr);
+#ifdef ALLOC_PROFILE
+	writeAllocReport(string(argv[2]) + "/alloc.txt");
+#endif
+	return report.failed > 0 ? -1 : 0;
 }
 
 int main(int argc, char *argv[]) {
-	if (argc < 2) {
-		cout << "Error in entering arguments. Correct Format: ./compiler <input.tex> <output.md>" << endl;
+	if (argc < 3) {
+		cout << "Error in entering arguments. Correct Format: ./compiler <input.tex> <output.md | output-dir> [--plain-math] [--split] [--html] [--json] [--bib refs.bib] [limits] [--stats]" << endl;
+		cout << "Batch mode: ./compiler --batch <output-dir> <input.tex>... [--plain-math] [--html] [--json] [--bib refs.bib] [limits] [--queue-depth N] [--workers N]" << endl;
+		cout << "Limits per document: [--max-nodes N] [--max-depth N] [--max-output BYTES] [--max-seconds S]" << endl;
 		return -1;
 	}
 
-	yyin = fopen(argv[1], "r");
-	if (!yyin) {
+	if (strcmp(argv[1], "--batch") == 0) return runBatch(argc, argv);
+
+	auto start = chrono::steady_clock::now();
+	converter C;
+	bool split = false;  //! Write one file per top-level section plus an index into the output directory
+	bibDatabase bib;     //! Entries for \cite, from --bib
+	htmlEmitter html(&bib);
+	jsonEmitter json;
+	vector<emitter*> extraFormats;  //! Formats written next to the Markdown output, from the same traversal
+	resourceLimits limits = defaultLimits();
+	bool stats = false;  //! Report size, wall time, throughput and peak RSS of the conversion on stderr
+	for (int i = 3; i < argc; i++) {
+		if (strcmp(argv[i], "--plain-math") == 0) C.setMathTransform(true);
+		else if (strcmp(argv[i], "--split") == 0) split = true;
+		else if (strcmp(argv[i], "--stats") == 0) stats = true;
+		else if (strcmp(argv[i], "--html") == 0) extraFormats.push_back(&html);
+		else if (strcmp(argv[i], "--json") == 0) extraFormats.push_back(&json);
+		else if (strcmp(argv[i], "--bib") == 0 && i + 1 < argc) {
+			if (!openBibliography(bib, argv[++i])) return -1;
+			C.setBibliography(&bib);
+		}
+		else if (parseLimit(argc, argv, i, limits)) continue;
+		else {
+			cout << "Unknown option: " << argv[i] << endl;
+			return -1;
+		}
+	}
+
+	vector<char> input;
+	if (!readInput(argv[1], input)) {
 		cout << "Error opening file: " << argv[1] << endl;
 		return -1;
 	}
-	do {
-		yyparse();
-	} while (!feof(yyin));
+	size_t inputBytes = input.size() - 2;  //! Before macro expansion, so throughput is measured against the source
+	reportInvalidUtf8(argv[1], input);
+	beginBudget(limits);
+	try {
+		vector<int> sourceLines;  //! Source line of each line after macro expansion, for locating syntax errors
+		expandMacros(input, argv[1], &sourceLines);
+		parseResult parsed;
+		{
+			PROFILE_PHASE(PHASE_PARSE);
+			parsed = parseDocument(input, sourceLines);
+		}
+		printParseErrors(argv[1], parsed, cerr);
+		if (!parsed.tree) return -1;
+		ASTNode* tree = parsed.tree;
 
-	converter C;
-	astManager.print(root, 1);
-	string s = C.traversal(root);
-	C.printMarkdown(s, argv[2]);
+		if (!stats) astManager.print(tree, 1);  //! The AST dump would dominate the timed run
+		if (split) {
+			vector<sectionChunk> chunks;
+			{
+				PROFILE_PHASE(PHASE_CONVERT);
+				chunks = C.splitSections(tree, extraFormats);
+			}
+			if (!C.printSplitMarkdown(chunks, argv[2])) return -1;
+			for (auto format : extraFormats) {
+				C.printMarkdown(format->output(), string(argv[2]) + "/document." + format->extension());
+			}
+		} else {
+			markdownEmitter markdown(C);
+			vector<emitter*> formats(1, &markdown);
+			formats.insert(formats.end(), extraFormats.begin(), extraFormats.end());
+			{
+				PROFILE_PHASE(PHASE_CONVERT);
+				emitDocument(tree, formats);
+			}
+			C.printMarkdown(markdown.output(), argv[2]);
+			for (auto format : extraFormats) {
+				C.printMarkdown(format->output(), replaceExtension(argv[2], format->extension()));
+			}
+		}
+	} catch (const budgetExceeded& e) {
+		cerr << argv[1] << ": conversion aborted: " << e.what() << endl;
+		return -1;
+	}
+	endBudget();
+	if (stats) printRunStats(cerr, inputBytes, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+#ifdef ALLOC_PROFILE
+	writeAllocReport(split ? string(argv[2]) + "/alloc.txt" : string(argv[2]) + ".alloc.txt");
+#endif
 
-	fclose(yyin);
 	return 0;
 }
@@ -0,0 +1,75 @@
+#include "mathmode.h"
+#include "budget.h"
+#include <cctype>
+#include <cstring>
+
+//! Returns the end of the balanced group that starts after an opening `open` at `p`
+static const char* groupEnd(const char* p, const char* end, char open, char close) {
+    int depth = 1;
+    for (; p < end; p++) {
+        if (*p == '\\' && p + 1 < end) { p++; continue; }  //! Skip escaped characters such as \{
+        if (*p == open) depth++;
+        else if (*p == close && --depth == 0) return p;
+    }
+    return end;
+}
+
+//! Appends a STRING_H run holding [begin, end) to `parent`
+static void addRun(const char* begin, const char* end, ASTNode* parent) {
+    ASTNode* run = astManager.newNode(STRING_H);
+    run->data.assign(begin, end);
+    parent->addChild(run);
+}
+
+//! Appends the math in [p, end) to `parent`, splitting out \sqrt commands.
+//! Nested radicands recurse, so they count against the depth and node limits like the document tree.
+static void parseMathRange(const char* p, const char* end, ASTNode* parent) {
+    depthScope scope;
+    checkBudget();
+    static const char SQRT[] = "\\sqrt";
+    const size_t SQRT_LEN = sizeof(SQRT) - 1;
+    const char* run = p;
+
+    while (p < end) {
+        const char* hit = static_cast<const char*>(memchr(p, '\\', end - p));
+        if (!hit) break;
+        bool isSqrt = (size_t)(end - hit) >= SQRT_LEN && memcmp(hit, SQRT, SQRT_LEN) == 0 &&
+                      (hit + SQRT_LEN == end || !isalpha((unsigned char)hit[SQRT_LEN]));
+        if (!isSqrt) { p = hit + 1 < end ? hit + 2 : end; continue; }  //! Skip the escaped character
+
+        if (hit > run) addRun(run, hit, parent);
+        ASTNode* sqrtNode = astManager.newNode(SQRT_H);
+        parent->addChild(sqrtNode);  //! Owned by the tree before recursing, so it is freed if the budget runs out
+        p = hit + SQRT_LEN;
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+        //! Optional root index: \sqrt[n]{...}
+        if (p < end && *p == '[') {
+            const char* close = groupEnd(p + 1, end, '[', ']');
+            sqrtNode->attributes.assign(p + 1, close);
+            p = close < end ? close + 1 : end;
+        }
+        //! Radicand is either a braced group or a single character
+        if (p < end && *p == '{') {
+            const char* close = groupEnd(p + 1, end, '{', '}');
+            parseMathRange(p + 1, close, sqrtNode);
+            p = close < end ? close + 1 : end;
+        } else if (p < end) {
+            parseMathRange(p, p + 1, sqrtNode);
+            p++;
+        }
+        run = p;
+    }
+    if (end > run) addRun(run, end, parent);
+}
+
+ASTNode* parseMath(const TextSpan& span) {
+    ASTNode* root = astManager.newNode(TEXT_H);
+    try {
+        if (span.ptr) parseMathRange(span.ptr, span.ptr + span.len, root);
+    } catch (const budgetExceeded&) {
+        delete root;
+        throw;
+    }
+    return root;
+}
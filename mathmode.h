@@ -0,0 +1,12 @@
+#ifndef MATHMODE_H
+#define MATHMODE_H
+
+#include "ast.h"
+
+//! Parses the body of a math region into a TEXT_H node whose children are STRING_H runs
+//! and SQRT_H nodes (the optional root index is stored in `attributes`).
+//! Math is normally passed through untouched; this is only used when a transformation is requested.
+//! Throws budgetExceeded if the math runs over the node or depth limit of the current thread (budget.h).
+ASTNode* parseMath(const TextSpan& span);
+
+#endif //! MATHMODE_H
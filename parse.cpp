@@ -0,0 +1,53 @@
+#include "parse.h"
+#include "budget.h"
+#include "parser.tab.hpp"
+#include <ostream>
+
+extern int yyparse();
+extern void lexFromBuffer(char* buffer, size_t size);
+extern ASTNode* root;
+
+static const size_t MAX_ERRORS = 100;                      //! Errors kept per document; garbage input is not reported in full
+static std::vector<syntaxError>* currentErrors = nullptr;  //! Errors of the document being parsed
+
+//! Called by the parser and the scanner for each syntax error; records it at the location of the current token
+void yyerror(const char* message) {
+    if (!budgetFailure().empty()) return;  //! The scanner stopped the parse on purpose; the exceeded limit is reported instead
+    if (!currentErrors || currentErrors->size() > MAX_ERRORS) return;
+    syntaxError error = { yylloc.first_line, yylloc.first_column, message };
+    if (currentErrors->size() == MAX_ERRORS) error.message = "too many syntax errors, the rest are not reported";
+    currentErrors->push_back(error);
+}
+
+//! Parses a scanner input buffer; errors are collected in the result instead of ending the process
+parseResult parseDocument(std::vector<char>& buffer, const std::vector<int>& sourceLines) {
+    parseResult result;
+    result.tree = nullptr;
+    currentErrors = &result.errors;
+    root = nullptr;
+    lexFromBuffer(buffer.data(), buffer.size() - 2);
+    int status = yyparse();
+    currentErrors = nullptr;
+    for (auto& error : result.errors) {
+        if (error.line >= 1 && static_cast<size_t>(error.line) <= sourceLines.size()) {
+            error.line = sourceLines[error.line - 1];
+        }
+    }
+
+    if (!budgetFailure().empty()) result.failure = budgetFailure();
+    else if (status == 2) result.failure = "nested too deeply for the parser";
+    else if (status != 0) result.failure = "could not recover from syntax errors";
+    if (result.failure.empty()) result.tree = root;
+    else delete root;  //! The parse may have completed the start rule before giving up
+    root = nullptr;
+    return result;
+}
+
+//! Prints the errors of a parse as "file:line:column: message", then the failure if there is one
+void printParseErrors(const std::string& filename, const parseResult& result, std::ostream& out) {
+    for (auto& error : result.errors) {
+        out << filename << ":" << error.line << ":" << error.column << ": " << error.message << "\n";
+    }
+    if (!result.failure.empty()) out << filename << ": conversion aborted: " << result.failure << "\n";
+    out.flush();
+}
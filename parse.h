@@ -0,0 +1,31 @@
+#ifndef PARSE_H
+#define PARSE_H
+
+#include "ast.h"
+#include <string>
+#include <vector>
+
+//! A syntax error located in the input; lines and columns count from 1, columns in bytes
+struct syntaxError {
+    int line;
+    int column;
+    std::string message;
+};
+
+//! Outcome of parsing one document
+struct parseResult {
+    ASTNode* tree;                      //! The AST, owned by the caller; nullptr if the document could not be parsed
+    std::vector<syntaxError> errors;    //! Syntax errors in input order; the parts of the document around them were skipped
+    std::string failure;                //! Why there is no tree (unrecoverable syntax error, exceeded budget); empty otherwise
+};
+
+//! Parses a scanner input buffer (text followed by two NULs; see lexFromBuffer).
+//! The parser resynchronizes after syntax errors where it can, and never ends the process.
+//! If the buffer was macro-expanded, `sourceLines` (from expandMacros) maps the lines of errors back to the source.
+//! The scanner and parser keep global state: calls from several threads must be serialized.
+parseResult parseDocument(std::vector<char>& buffer, const std::vector<int>& sourceLines = std::vector<int>());
+
+//! Prints the errors of a parse to `out` as "file:line:column: message", then the failure if there is one
+void printParseErrors(const std::string& filename, const parseResult& result, std::ostream& out);
+
+#endif //! PARSE_H
@@ -1,130 +0,0 @@
-/* A Bison parser, made by GNU Bison 3.8.2.  */
-
-/* Bison interface for Yacc-like parsers in C
-
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
-   Inc.
-
-   This program is free software: you can redistribute it and/or modify
-   it under the terms of the GNU General Public License as published by
-   the Free Software Foundation, either version 3 of the License, or
-   (at your option) any later version.
-
-   This program is distributed in the hope that it will be useful,
-   but WITHOUT ANY WARRANTY; without even the implied warranty of
-   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-   GNU General Public License for more details.
-
-   You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
-
-/* As a special exception, you may create a larger work that contains
-   part or all of the Bison parser skeleton and distribute that work
-   under terms of your choice, so long as that work isn't itself a
-   parser generator using the skeleton or a modified version thereof
-   as a parser skeleton.  Alternatively, if you modify or redistribute
-   the parser skeleton itself, you may (at your option) remove this
-   special exception, which will cause the skeleton and the resulting
-   Bison output files to be licensed under the GNU General Public
-   License without this special exception.
-
-   This special exception was added by the Free Software Foundation in
-   version 2.2 of Bison.  */
-
-/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
-   especially those whose name start with YY_ or yy_.  They are
-   private implementation details that can be changed or removed.  */
-
-#ifndef YY_YY_PARSER_TAB_HPP_INCLUDED
-# define YY_YY_PARSER_TAB_HPP_INCLUDED
-/* Debug traces.  */
-#ifndef YYDEBUG
-# define YYDEBUG 0
-#endif
-#if YYDEBUG
-extern int yydebug;
-#endif
-
-/* Token kinds.  */
-#ifndef YYTOKENTYPE
-# define YYTOKENTYPE
-  enum yytokentype
-  {
-    YYEMPTY = -2,
-    YYEOF = 0,                     /* "end of file"  */
-    YYerror = 256,                 /* error  */
-    YYUNDEF = 257,                 /* "invalid token"  */
-    STRING = 258,                  /* STRING  */
-    CODE = 259,                    /* CODE  */
-    FIGURE_PATH = 260,             /* FIGURE_PATH  */
-    FIGURE_SPECS = 261,            /* FIGURE_SPECS  */
-    HEADING = 262,                 /* HEADING  */
-    MATH_STRING = 263,             /* MATH_STRING  */
-    FIG_ARGS = 264,                /* FIG_ARGS  */
-    TABLE_ARGS = 265,              /* TABLE_ARGS  */
-    TITLE = 266,                   /* TITLE  */
-    DATE = 267,                    /* DATE  */
-    START_VERBATIM = 268,          /* START_VERBATIM  */
-    END_VERBATIM = 269,            /* END_VERBATIM  */
-    END_CURLY = 270,               /* END_CURLY  */
-    BEGIN_DOCUMENT = 271,          /* BEGIN_DOCUMENT  */
-    END_DOCUMENT = 272,            /* END_DOCUMENT  */
-    ITEM = 273,                    /* ITEM  */
-    BEGIN_ITEMIZE = 274,           /* BEGIN_ITEMIZE  */
-    END_ITEMIZE = 275,             /* END_ITEMIZE  */
-    BEGIN_ENUMERATE = 276,         /* BEGIN_ENUMERATE  */
-    END_ENUMERATE = 277,           /* END_ENUMERATE  */
-    SECTION = 278,                 /* SECTION  */
-    SUBSECTION = 279,              /* SUBSECTION  */
-    SUBSUBSECTION = 280,           /* SUBSUBSECTION  */
-    ENDL = 281,                    /* ENDL  */
-    T_BF = 282,                    /* T_BF  */
-    T_IT = 283,                    /* T_IT  */
-    T_U = 284,                     /* T_U  */
-    BEGIN_TABULAR = 285,           /* BEGIN_TABULAR  */
-    END_TABULAR = 286,             /* END_TABULAR  */
-    HLINE = 287,                   /* HLINE  */
-    AMPERSAND = 288,               /* AMPERSAND  */
-    DSLASH = 289,                  /* DSLASH  */
-    BEGIN_FIGURE = 290,            /* BEGIN_FIGURE  */
-    BEGIN_SQUARE = 291,            /* BEGIN_SQUARE  */
-    END_FIGURE = 292,              /* END_FIGURE  */
-    END_SQUARE = 293,              /* END_SQUARE  */
-    INCLUDE_GRAPHICS = 294,        /* INCLUDE_GRAPHICS  */
-    CAPTION = 295,                 /* CAPTION  */
-    COMMA = 296,                   /* COMMA  */
-    BEGIN_CURLY = 297,             /* BEGIN_CURLY  */
-    PAR = 298,                     /* PAR  */
-    LABEL_TAG = 299,               /* LABEL_TAG  */
-    REF_TAG = 300,                 /* REF_TAG  */
-    HRULE = 301,                   /* HRULE  */
-    HREF = 302                     /* HREF  */
-  };
-  typedef enum yytokentype yytoken_kind_t;
-#endif
-
-/* Value type.  */
-#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-union YYSTYPE
-{
-#line 24 "/Users/divyanshudwivedi2018gmail.com/Desktop/SSL/final-A1/parser.y"
-
-    std::string* svalue;
-    ASTNode* node;
-
-#line 116 "parser.tab.hpp"
-
-};
-typedef union YYSTYPE YYSTYPE;
-# define YYSTYPE_IS_TRIVIAL 1
-# define YYSTYPE_IS_DECLARED 1
-#endif
-
-
-extern YYSTYPE yylval;
-
-
-int yyparse (void);
-
-
-#endif /* !YY_YY_PARSER_TAB_HPP_INCLUDED  */
@@ -17,6 +17,43 @@ extern int yylex();
 extern void yyerror(const char*);
 extern FILE *yyin;
 extern ASTNode* root;
+
+//! Merges a part of a figure environment into the FIGURE_H node: the image path is kept as data,
+//! captions and labels become children
+static void addFigurePart(ASTNode* figure, ASTNode* part) {
+    if (part->node_type == FIGURE_H) {
+        figure->data = part->data;
+        delete part;
+    } else {
+        figure->addChild(part);
+    }
+}
+
+//! Appends a STRING token to `text` with its whitespace runs collapsed to single spaces.
+//! Consecutive tokens are merged into the trailing STRING_H run instead of getting a node each.
+static void appendText(ASTNode* text, std::string* token) {
+    std::string normalized;
+    normalized.reserve(token->size());
+    for (char ch : *token) {
+        if (ch == ' ' || ch == '\t') {
+            if (!normalized.empty() && normalized.back() != ' ') normalized += ' ';
+        } else {
+            normalized += ch;
+        }
+    }
+    if (!normalized.empty() && normalized.back() == ' ') normalized.pop_back();
+    delete token;
+
+    ASTNode* run = text->children.empty() ? text : text->children.back();
+    if (run->node_type == STRING_H && run->children.empty()) {
+        if (!run->data.empty() && !normalized.empty()) run->data += ' ';
+        run->data += normalized;
+        return;
+    }
+    ASTNode* stringNode = astManager.newNode(STRING_H);
+    stringNode->data = normalized;
+    text->addChild(stringNode);
+}
 %}
 
 //!Defines a union to handle different types of values in the grammar. The parser can return either strings (svalue) or AST nodes (node).
@@ -24,6 +61,7 @@ extern ASTNode* root;
 %union {
     std::string* svalue;
     ASTNode* node;
+    TextSpan span;
 }
 
 /*##
@@ -33,17 +71,41 @@ Specifies the types of non-terminal symbols in the grammar.
 
 %start start 
 
-%token <svalue> STRING CODE FIGURE_PATH FIGURE_SPECS HEADING MATH_STRING FIG_ARGS TABLE_ARGS
+/*##Tokens carry their line and column (set by the scanner) so that syntax errors can be located; messages name the
+unexpected token and what was expected instead.*/
+
+%locations
+%define parse.error verbose
+
+/*##The grammar is conflict-free; bison fails on any new conflict instead of resolving it silently.*/
+
+%expect 0
+
+%token <svalue> STRING CODE FIGURE_PATH FIGURE_SPECS HEADING MATH_STRING FIG_ARGS TABLE_ARGS CITE_NOTE
 %token TITLE DATE START_VERBATIM END_VERBATIM END_CURLY BEGIN_DOCUMENT END_DOCUMENT ITEM BEGIN_ITEMIZE END_ITEMIZE
 %token BEGIN_ENUMERATE END_ENUMERATE SECTION SUBSECTION SUBSUBSECTION ENDL T_BF T_IT T_U BEGIN_TABULAR END_TABULAR
 %token HLINE AMPERSAND DSLASH BEGIN_FIGURE BEGIN_SQUARE END_FIGURE END_SQUARE INCLUDE_GRAPHICS CAPTION COMMA
-%token BEGIN_CURLY PAR LABEL_TAG REF_TAG HRULE HREF
+%token BEGIN_CURLY PAR LABEL_TAG REF_TAG CITE_TAG HRULE HREF
+%token RESOURCE_LIMIT
+%token <span> INLINE_MATH DISPLAY_MATH
 %type <node> start title date begin_document content list ul ol items verbatim section subsection subsubsection bold 
-%type <node> italic figure text hrule tabular row rows cell cells href code content_element
+%type <node> italic figure text hrule tabular row rows cell cells href code content_element math cite
+%type <node> graphics figure_body figure_part caption label ref citation_keys
+
+/*##RESOURCE_LIMIT comes from the scanner once the document's budget (budget.h) is spent. No rule accepts it, so the
+parse fails there; the destructors free the values of everything the parser discards on the way out.*/
+
+%destructor { delete $$; } <svalue> <node>
 
 /*##Specifies the precedence of certain operators to resolve conflicts during parsing .*/
 
+/*##A text run ends only when the next token cannot continue it: a string, formatting, math, \ref, \cite or \href
+extends the current run, and so does a paragraph break, instead of ending the run and starting a new element.
+TEXT_END is never returned by the scanner; it only ranks the end of a run below both.*/
+
+%nonassoc TEXT_END
 %left PAR
+%nonassoc STRING T_BF T_IT REF_TAG CITE_TAG HREF INLINE_MATH DISPLAY_MATH
 %left AMPERSAND DSLASH
 
 %%
@@ -57,6 +119,7 @@ start: title date begin_document {
     root->addChild($1);
     root->addChild($2);
     root->addChild($3);
+    $$ = nullptr;  //! The tree belongs to root; the parser's cleanup of the start symbol must not free it
 };
 
 /*##These rules create TITLE_H and DATE_H nodes, storing the corresponding string data.*/
@@ -86,16 +149,16 @@ begin_document: BEGIN_DOCUMENT content END_DOCUMENT {
 Content elements are added as children to the document node.*/
 
 content:
-    content_element {
-        $$ = astManager.newNode(DOCUMENT_H);
-        $$->addChild($1);
-    }
-    | content content_element {
+    content content_element {
         $$ = $1;
         $$->addChild($2);
     }
     | /*## empty */ {
         $$ = astManager.newNode(DOCUMENT_H);
+    }
+    | content error {
+        //! Outside of an environment, tokens are dropped until one that can start a block (section, list, text, ...)
+        $$ = $1;
     };
 
 content_element:
@@ -104,10 +167,11 @@ content_element:
   | section
   | subsection
   | subsubsection
-  | text
+  | text %prec TEXT_END
   | figure
   | hrule
-  | tabular;
+  | tabular
+  | label;
 
 /*##Handles unordered (ul) and ordered (ol) lists, where items are added as children to ITEMIZE_H or ENUMERATE_H nodes.*/
 
@@ -119,12 +183,18 @@ list: ul { $$ = $1; }
 ul: BEGIN_ITEMIZE items END_ITEMIZE {
     $$ = astManager.newNode(ITEMIZE_H);
     $$->addChild($2);
+}
+    | BEGIN_ITEMIZE error END_ITEMIZE {  //! A malformed list is skipped up to its \end
+    $$ = astManager.newNode(ITEMIZE_H);
 };
 
 //! Ordered list
 ol: BEGIN_ENUMERATE items END_ENUMERATE {
     $$ = astManager.newNode(ENUMERATE_H);
     $$->addChild($2);
+}
+    | BEGIN_ENUMERATE error END_ENUMERATE {
+    $$ = astManager.newNode(ENUMERATE_H);
 };
 
 //! Items in lists
@@ -146,24 +216,34 @@ items: items ITEM text {
     $$ = $1;
 };
 
-/*##Handles sections, subsections, and subsubsections by creating corresponding nodes and assigning the section title data.*/
+/*##Handles sections, subsections, and subsubsections by creating corresponding nodes and assigning the section title data.
+A heading whose title cannot be parsed is kept without a title, so that the numbering of the following sections stays right.*/
 
 section: SECTION BEGIN_CURLY STRING END_CURLY {
     $$ = astManager.newNode(SECTION_H);
     $$->data = *$3;
     delete $3;
+}
+    | SECTION BEGIN_CURLY error END_CURLY {
+    $$ = astManager.newNode(SECTION_H);
 };
 
 subsection: SUBSECTION BEGIN_CURLY STRING END_CURLY {
     $$ = astManager.newNode(SUBSECTION_H);
     $$->data = *$3;
     delete $3;
+}
+    | SUBSECTION BEGIN_CURLY error END_CURLY {
+    $$ = astManager.newNode(SUBSECTION_H);
 };
 
 subsubsection: SUBSUBSECTION BEGIN_CURLY STRING END_CURLY {
     $$ = astManager.newNode(SUBSUBSECTION_H);
     $$->data = *$3;
     delete $3;
+}
+    | SUBSUBSECTION BEGIN_CURLY error END_CURLY {
+    $$ = astManager.newNode(SUBSUBSECTION_H);
 };
 
 /*##Handles verbatim environments by concatenating CODE tokens into a single VERBATIM_H node's data.*/
@@ -176,15 +256,15 @@ verbatim: START_VERBATIM code END_VERBATIM {
 
 code: code CODE {
     //! Append the new CODE token to the VERBATIM_H node's data
-    (yyval.node) = (yyvsp[-1].node);  //! Use the existing VERBATIM_H node
-    (yyval.node)->data += *(yyvsp[0].svalue);  //! Concatenate the new CODE data
-    delete (yyvsp[0].svalue);  //! Clean up the CODE token
+    $$ = $1;  //! Use the existing VERBATIM_H node
+    $$->data += *$2;  //! Concatenate the new CODE data
+    delete $2;  //! Clean up the CODE token
 }
 | CODE {
     //! Initialize the VERBATIM_H node with the first CODE token
-    (yyval.node) = astManager.newNode(VERBATIM_H);
-    (yyval.node)->data = *(yyvsp[0].svalue);  //! Assign the CODE token data
-    delete (yyvsp[0].svalue);  //! Clean up the CODE token
+    $$ = astManager.newNode(VERBATIM_H);
+    $$->data = *$1;  //! Assign the CODE token data
+    delete $1;  //! Clean up the CODE token
 };
 
 
@@ -204,21 +284,88 @@ italic: T_IT BEGIN_CURLY STRING END_CURLY {
 
 /*##Handles figures, where the image path is stored in the FIGURE_H node's data.*/
 
-figure: INCLUDE_GRAPHICS BEGIN_SQUARE FIG_ARGS END_SQUARE BEGIN_CURLY STRING END_CURLY {
+figure: graphics
+    | BEGIN_FIGURE figure_body END_FIGURE {
+    $$ = $2;
+}
+    | BEGIN_FIGURE BEGIN_SQUARE FIG_ARGS END_SQUARE figure_body END_FIGURE {
+    $$ = $5;
+    delete $3;
+}
+    | BEGIN_FIGURE error END_FIGURE {  //! A malformed figure is skipped up to its \end
+    $$ = astManager.newNode(FIGURE_H);
+};
+
+graphics: INCLUDE_GRAPHICS BEGIN_SQUARE FIG_ARGS END_SQUARE BEGIN_CURLY STRING END_CURLY {
     $$ = astManager.newNode(FIGURE_H);
     $$->data = *$6;
+    delete $3;
     delete $6;
 };
 
+/*##The body of a figure environment: the image, its caption and its label, in any order.*/
+
+figure_body: figure_body figure_part {
+    $$ = $1;
+    addFigurePart($$, $2);
+}
+    | figure_part {
+    $$ = astManager.newNode(FIGURE_H);
+    addFigurePart($$, $1);
+};
+
+figure_part: graphics
+    | caption
+    | label;
+
+caption: CAPTION BEGIN_CURLY STRING END_CURLY {
+    $$ = astManager.newNode(CAPTION_H);
+    $$->data = *$3;
+    delete $3;
+};
+
+/*##Handles \label and \ref. Labels name the most recent section or figure; the converter resolves
+references in its single traversal and back-patches forward references at the end.*/
+
+label: LABEL_TAG BEGIN_CURLY STRING END_CURLY {
+    $$ = astManager.newNode(LABEL_H);
+    $$->data = *$3;
+    delete $3;
+};
+
+ref: REF_TAG BEGIN_CURLY STRING END_CURLY {
+    $$ = astManager.newNode(REF_H);
+    $$->data = *$3;
+    delete $3;
+};
+
+/*##Handles \cite. The keys are kept comma-separated with surrounding spaces removed; the converter numbers
+them in citation order and lists them in the references section. An optional note (\cite[p.~5]{key}) is kept in
+the node's attributes and printed after the numbers.*/
+
+cite: CITE_TAG citation_keys {
+    $$ = $2;
+}
+    | CITE_TAG CITE_NOTE citation_keys {
+    $$ = $3;
+    $$->attributes = *$2;
+    delete $2;
+};
+
+citation_keys: BEGIN_CURLY STRING END_CURLY {
+    $$ = astManager.newNode(CITE_H);
+    for (char ch : *$2) {
+        if (ch != ' ' && ch != '\t' && ch != '\n') $$->data += ch;
+    }
+    delete $2;
+};
+
 /*##Handles text and paragraph (PAR_H) elements, where different text formatting (bold, italic) and plain text (STRING_H) are combined.*/
 
 text:
     text STRING {
         $$ = $1;
-        ASTNode* stringNode = astManager.newNode(STRING_H);
-        stringNode->data = *$2;
-        delete $2;
-        $$->addChild(stringNode);
+        appendText($$, $2);
     }
     | text bold {
         $$ = $1;
@@ -238,6 +385,18 @@ text:
         $$ = $1;
         $$->addChild($2);
     }
+    | text math {
+        $$ = $1;
+        $$->addChild($2);
+    }
+    | text ref {
+        $$ = $1;
+        $$->addChild($2);
+    }
+    | text cite {
+        $$ = $1;
+        $$->addChild($2);
+    }
     | href
     | text PAR {
         $$ = $1;
@@ -259,12 +418,35 @@ text:
         $$ = astManager.newNode(TEXT_H);
         $$->addChild($1);
     }
+    | math {
+        $$ = astManager.newNode(TEXT_H);
+        $$->addChild($1);
+    }
+    | ref {
+        $$ = astManager.newNode(TEXT_H);
+        $$->addChild($1);
+    }
+    | cite {
+        $$ = astManager.newNode(TEXT_H);
+        $$->addChild($1);
+    }
     | STRING {
         $$ = astManager.newNode(STRING_H);
-        $$->data = *$1;
-        delete $1;
+        appendText($$, $1);
     };
 
+/*##Handles inline (MATH_H) and display (DISPLAY_MATH_H) math. The body is kept as a span into the input
+buffer and copied to the output only once; it is parsed only if the converter is asked to transform math.*/
+
+math: INLINE_MATH {
+    $$ = astManager.newNode(MATH_H);
+    $$->span = $1;
+}
+    | DISPLAY_MATH {
+    $$ = astManager.newNode(DISPLAY_MATH_H);
+    $$->span = $1;
+};
+
 /*##Handles tables (TABULAR_H) by defining rows (ROW_H) and cells (CELL_H) within the table.*/
 
 tabular: BEGIN_TABULAR BEGIN_CURLY TABLE_ARGS END_CURLY HLINE rows END_TABULAR {
@@ -272,6 +454,9 @@ tabular: BEGIN_TABULAR BEGIN_CURLY TABLE_ARGS END_CURLY HLINE rows END_TABULAR {
     $$->data = *$3;
     delete $3;
     $$->addChild($6);
+}
+    | BEGIN_TABULAR error END_TABULAR {  //! A malformed table is skipped up to its \end
+    $$ = astManager.newNode(TABULAR_H);
 };
 
 rows: rows row {
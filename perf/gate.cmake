@@ -0,0 +1,165 @@
+# Performance regression gate, run by ctest as `cmake -P perf/gate.cmake` (see CMakeLists.txt).
+#
+# Every corpus document is scaled up by repeating its body SCALE times, then converted RUNS times with
+# `compiler --stats`. The best throughput and the lowest peak RSS of the runs are compared with BASELINE:
+# the gate fails if throughput drops by more than TOLERANCE percent or peak RSS grows by more than
+# RSS_TOLERANCE percent. A missing baseline, or a document missing from it, fails the gate as well. The
+# numbers of every run are written to WORK_DIR/measured.txt in the baseline format; only UPDATE=ON writes
+# them to BASELINE, in place of the comparison.
+#
+# math.tex, a math-dense document, is also compared with prose.tex, plain text of the same size: the gate fails if
+# it runs at less than MATH_RATIO percent of its throughput.
+#
+# Inputs: COMPILER, SOURCE_DIR, WORK_DIR, BASELINE, SCALE, RUNS, TOLERANCE, RSS_TOLERANCE, MATH_RATIO, UPDATE
+
+set(CORPUS
+    "${SOURCE_DIR}/input.tex"
+    "${SOURCE_DIR}/perf/markup.tex"
+    "${SOURCE_DIR}/perf/citations.tex"
+    "${SOURCE_DIR}/perf/math.tex"
+    "${SOURCE_DIR}/perf/prose.tex"
+)
+set(BIB "${SOURCE_DIR}/perf/references.bib")
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+# Writes `source` to `target` with the text between \begin{document} and \end{document} repeated `times` times
+function(scale_document source target times)
+    file(READ "${source}" text)
+    string(FIND "${text}" "\\begin{document}" begin)
+    string(FIND "${text}" "\\end{document}" end)
+    if(begin EQUAL -1 OR end EQUAL -1)
+        message(FATAL_ERROR "${source}: no document environment to scale")
+    endif()
+    string(LENGTH "\\begin{document}" length)
+    math(EXPR bodyStart "${begin} + ${length}")
+    math(EXPR bodyLength "${end} - ${bodyStart}")
+    string(SUBSTRING "${text}" 0 ${bodyStart} scaled)
+    string(SUBSTRING "${text}" ${bodyStart} ${bodyLength} body)
+    # Repeated doubling: appending the body once per repetition copies the growing text quadratically often
+    set(power "${body}")
+    set(n ${times})
+    while(n GREATER 0)
+        math(EXPR bit "${n} % 2")
+        if(bit)
+            string(APPEND scaled "${power}")
+        endif()
+        math(EXPR n "${n} / 2")
+        if(n GREATER 0)
+            string(APPEND power "${power}")
+        endif()
+    endwhile()
+    string(APPEND scaled "\\end{document}\n")
+    file(WRITE "${target}" "${scaled}")
+endfunction()
+
+# math() only knows integers, so throughputs ("12.345" MB/s, as printed by --stats) are compared in kB/s
+function(to_kbps value result)
+    string(REGEX MATCH "^([0-9]+)\\.([0-9][0-9][0-9])$" matched "${value}")
+    if(NOT matched)
+        message(FATAL_ERROR "malformed throughput '${value}'")
+    endif()
+    math(EXPR kbps "${CMAKE_MATCH_1} * 1000 + ${CMAKE_MATCH_2}")
+    set(${result} ${kbps} PARENT_SCOPE)
+endfunction()
+
+# Baseline lines are "document throughput_mb_s peak_rss_kb"; lines starting with '#' are comments
+set(known "")
+if(NOT UPDATE)
+    if(NOT EXISTS "${BASELINE}")
+        message(FATAL_ERROR "No performance baseline at ${BASELINE}; record one with -DPERF_UPDATE_BASELINE=ON")
+    endif()
+    file(STRINGS "${BASELINE}" lines REGEX "^[^#]")
+    foreach(line ${lines})
+        if(line MATCHES "^([^ \t]+)[ \t]+([0-9]+\\.[0-9][0-9][0-9])[ \t]+([0-9]+)")
+            set(baselineThroughput_${CMAKE_MATCH_1} ${CMAKE_MATCH_2})
+            set(baselineRss_${CMAKE_MATCH_1} ${CMAKE_MATCH_3})
+            list(APPEND known ${CMAKE_MATCH_1})
+        endif()
+    endforeach()
+endif()
+
+set(failures "")
+set(measured "")
+foreach(source ${CORPUS})
+    get_filename_component(name "${source}" NAME)
+    set(scaled "${WORK_DIR}/${name}")
+    scale_document("${source}" "${scaled}" ${SCALE})
+
+    set(bestKbps -1)
+    set(lowestRss -1)
+    foreach(run RANGE 1 ${RUNS})
+        execute_process(
+            COMMAND "${COMPILER}" "${scaled}" "${WORK_DIR}/${name}.md" --bib "${BIB}" --stats
+            WORKING_DIRECTORY "${WORK_DIR}"
+            RESULT_VARIABLE status
+            OUTPUT_QUIET
+            ERROR_VARIABLE stats)
+        # A document that no longer parses cleanly does less work, which would pass for a speedup
+        if(NOT status EQUAL 0 OR stats MATCHES "syntax error")
+            message(FATAL_ERROR "${name}: the corpus document no longer converts cleanly (exit status ${status}):\n${stats}")
+        endif()
+        if(NOT stats MATCHES "bytes\t([0-9]+)\n.*throughput_mb_s\t([0-9.]+)\npeak_rss_kb\t([0-9]+)")
+            message(FATAL_ERROR "${name}: compiler --stats printed no measurements:\n${stats}")
+        endif()
+        set(bytes ${CMAKE_MATCH_1})
+        set(throughput ${CMAKE_MATCH_2})
+        set(rss ${CMAKE_MATCH_3})
+        to_kbps(${throughput} kbps)
+        # Timing noise only ever slows a run down, so the fastest run is the most repeatable measurement
+        if(kbps GREATER bestKbps)
+            set(bestKbps ${kbps})
+            set(bestThroughput ${throughput})
+        endif()
+        if(lowestRss EQUAL -1 OR rss LESS lowestRss)
+            set(lowestRss ${rss})
+        endif()
+    endforeach()
+
+    set(bestKbps_${name} ${bestKbps})
+    set(line "${name}: ${bytes} bytes, ${bestThroughput} MB/s, peak RSS ${lowestRss} KiB")
+    string(APPEND measured "${name} ${bestThroughput} ${lowestRss}\n")
+    if(UPDATE)
+        message(STATUS "${line} (recorded as the baseline)")
+        continue()
+    endif()
+    list(FIND known ${name} index)
+    if(index EQUAL -1)
+        message(STATUS "${line} (not in the baseline)")
+        string(APPEND failures "${name}: missing from ${BASELINE}; record it with -DPERF_UPDATE_BASELINE=ON\n")
+        continue()
+    endif()
+
+    set(base ${baselineThroughput_${name}})
+    set(baseRss ${baselineRss_${name}})
+    to_kbps(${base} baseKbps)
+    math(EXPR minKbps "${baseKbps} * (100 - ${TOLERANCE}) / 100")
+    math(EXPR maxRss "${baseRss} * (100 + ${RSS_TOLERANCE}) / 100")
+    message(STATUS "${line} (baseline ${base} MB/s, ${baseRss} KiB)")
+    if(bestKbps LESS minKbps)
+        string(APPEND failures "${name}: throughput ${bestThroughput} MB/s is more than ${TOLERANCE}% below the baseline of ${base} MB/s\n")
+    endif()
+    if(lowestRss GREATER maxRss)
+        string(APPEND failures "${name}: peak RSS ${lowestRss} KiB is more than ${RSS_TOLERANCE}% above the baseline of ${baseRss} KiB\n")
+    endif()
+endforeach()
+
+# Math bodies are passed through as spans; math.tex still has about three times the tokens and nodes of prose.tex
+math(EXPR mathPercent "${bestKbps_math.tex} * 100 / ${bestKbps_prose.tex}")
+message(STATUS "math.tex runs at ${mathPercent}% of the throughput of prose.tex (at least ${MATH_RATIO}% required)")
+if(mathPercent LESS MATH_RATIO)
+    string(APPEND failures "math.tex: throughput is ${mathPercent}% of prose.tex, below ${MATH_RATIO}%\n")
+endif()
+
+set(header
+    "# Performance baseline of the corpus, scaled ${SCALE} times (see perf/gate.cmake)\n"
+    "# document throughput_mb_s peak_rss_kb\n")
+file(WRITE "${WORK_DIR}/measured.txt" ${header} "${measured}")
+if(UPDATE)
+    file(WRITE "${BASELINE}" ${header} "${measured}")
+    message(STATUS "Baseline written to ${BASELINE}")
+endif()
+
+if(NOT failures STREQUAL "")
+    message(FATAL_ERROR "Performance gate failed:\n${failures}")
+endif()
@@ -0,0 +1,246 @@
+#include "pipeline.h"
+#include "ast.h"
+#include "budget.h"
+#include "converter.h"
+#include "emitter.h"
+#include "macro.h"
+#include "parse.h"
+#include "profiler.h"
+#include "utf8.h"
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+
+//! Reads the whole file into `buffer`, followed by the two NUL bytes the scanner needs.
+//! The buffer is scanned in place, so math and other passthrough spans point straight into it.
+bool readInput(const char* filename, std::vector<char>& buffer) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    buffer.assign(size > 0 ? size + 2 : 2, '\0');
+    size_t got = size > 0 ? fread(buffer.data(), 1, size, file) : 0;
+    fclose(file);
+    buffer.resize(got + 2);
+    return true;
+}
+
+//! Reports invalid UTF-8 in the input with byte offsets; the scanner drops these bytes
+void reportInvalidUtf8(const char* filename, const std::vector<char>& buffer) {
+    const size_t MAX_REPORTED = 20;
+    std::vector<size_t> invalid = validateUtf8(buffer.data(), buffer.size() - 2);
+    for (size_t i = 0; i < invalid.size() && i < MAX_REPORTED; i++) {
+        char message[128];
+        snprintf(message, sizeof(message), "%s: invalid UTF-8 byte 0x%02X at offset %zu (dropped)",
+                 filename, static_cast<unsigned char>(buffer[invalid[i]]), invalid[i]);
+        std::cerr << message << std::endl;
+    }
+    if (invalid.size() > MAX_REPORTED) {
+        std::cerr << filename << ": " << invalid.size() - MAX_REPORTED << " more invalid UTF-8 bytes" << std::endl;
+    }
+}
+
+//! A document on its way through the pipeline
+struct batchDocument {
+    std::string input;          //! Input path
+    std::string output;         //! Markdown output path; other formats are written next to it
+    std::vector<char> buffer;   //! Input text plus two NULs; must outlive the AST (spans point into it)
+    std::vector<std::pair<std::string, std::string> > outputs;  //! Path and content of every converted format
+};
+
+typedef std::unique_ptr<batchDocument> documentPtr;
+
+//! Seconds elapsed since `start`
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//! Output path for an input: its file name with the extension replaced by .md, inside `directory`
+static std::string outputPath(const std::string& input, const std::string& directory) {
+    size_t slash = input.find_last_of('/');
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) name = name.substr(0, dot);
+    return directory + "/" + name + ".md";
+}
+
+pipelineReport runPipeline(const std::vector<std::string>& inputs, const std::string& outputDirectory,
+                           const pipelineOptions& options) {
+    pipelineReport report = {};
+    mkdir(outputDirectory.c_str(), 0755);
+
+    boundedQueue<documentPtr> toConvert(options.queueDepth);
+    boundedQueue<documentPtr> toWrite(options.queueDepth);
+    std::mutex parserLock;   //! The flex scanner and bison parser keep global state, so one document is parsed at a time
+    std::mutex statsLock;
+    std::mutex failedLock;
+    std::atomic<size_t> recovered(0);
+
+    //! Reader: reads ahead up to queueDepth documents while the workers are busy
+    std::thread reader([&]() {
+        for (const std::string& input : inputs) {
+            auto start = std::chrono::steady_clock::now();
+            documentPtr document(new batchDocument());
+            document->input = input;
+            document->output = outputPath(input, outputDirectory);
+            if (!readInput(input.c_str(), document->buffer)) {
+                std::cerr << "Error opening file: " << input << std::endl;
+                std::lock_guard<std::mutex> guard(failedLock);
+                report.failed++;
+                continue;
+            }
+            reportInvalidUtf8(input.c_str(), document->buffer);
+            report.reader.busy += secondsSince(start);
+            report.reader.documents++;
+            toConvert.push(std::move(document), report.reader.outputWait);
+        }
+        toConvert.close();
+    });
+
+    //! Workers: expand macros, parse under the shared parser lock, then convert concurrently with their own converter.
+    //! Each document runs under its own budget; one that exceeds it, cannot be parsed or throws is reported and skipped.
+    std::vector<std::thread> workers;
+    unsigned workerCount = options.workers > 0 ? options.workers : 1;
+    for (unsigned w = 0; w < workerCount; w++) {
+        workers.emplace_back([&]() {
+            stageStats local = {};
+            converter C;
+            C.setMathTransform(options.mathTransform);
+            C.setBibliography(options.bib);
+            //! Frees what is left of a document that failed and counts it
+            auto dropDocument = [&](ASTNode* tree) {
+                delete tree;
+                endBudget();
+                std::lock_guard<std::mutex> guard(failedLock);
+                report.failed++;
+            };
+            documentPtr document;
+            while (toConvert.pop(document, local.inputWait)) {
+                ASTNode* tree = nullptr;
+                parseResult parsed;
+                beginBudget(options.limits);
+                try {
+                    auto expandStart = std::chrono::steady_clock::now();
+                    std::vector<int> sourceLines;
+                    expandMacros(document->buffer, document->input.c_str(), &sourceLines);
+                    local.busy += secondsSince(expandStart);
+                    {
+                        auto waitStart = std::chrono::steady_clock::now();
+                        std::lock_guard<std::mutex> guard(parserLock);
+                        local.parserWait += secondsSince(waitStart);
+                        auto start = std::chrono::steady_clock::now();
+                        PROFILE_PHASE(PHASE_PARSE);
+                        parsed = parseDocument(document->buffer, sourceLines);
+                        tree = parsed.tree;
+                        local.busy += secondsSince(start);
+                    }
+                    if (!parsed.errors.empty() || !tree) {
+                        std::ostringstream errors;
+                        printParseErrors(document->input, parsed, errors);
+                        std::cerr << errors.str();
+                    }
+                    if (!tree) {
+                        dropDocument(tree);
+                        continue;
+                    }
+                    if (!parsed.errors.empty()) recovered++;
+                    auto start = std::chrono::steady_clock::now();
+                    {
+                        PROFILE_PHASE(PHASE_CONVERT);
+                        markdownEmitter markdown(C);
+                        htmlEmitter html(options.bib);
+                        jsonEmitter json;
+                        std::vector<emitter*> formats(1, &markdown);
+                        if (options.html) formats.push_back(&html);
+                        if (options.json) formats.push_back(&json);
+                        emitDocument(tree, formats);
+                        for (auto format : formats) {
+                            std::string path = format == &markdown ? document->output : replaceExtension(document->output, format->extension());
+                            document->outputs.push_back(std::make_pair(path, format->output()));
+                        }
+                    }
+                    local.busy += secondsSince(start);
+                } catch (const budgetExceeded& e) {
+                    //! The document is dropped; the worker moves on to the next one
+                    std::cerr << document->input << ": conversion aborted: " << e.what() << std::endl;
+                    dropDocument(tree);
+                    continue;
+                } catch (const std::exception& e) {
+                    //! Anything else thrown while converting one document (e.g. std::bad_alloc) fails only that document
+                    std::cerr << document->input << ": conversion failed: " << e.what() << std::endl;
+                    dropDocument(tree);
+                    continue;
+                } catch (...) {
+                    std::cerr << document->input << ": conversion failed" << std::endl;
+                    dropDocument(tree);
+                    continue;
+                }
+                endBudget();
+                delete tree;
+                std::vector<char>().swap(document->buffer);
+                local.documents++;
+                toWrite.push(std::move(document), local.outputWait);
+            }
+            std::lock_guard<std::mutex> guard(statsLock);
+            report.convert.documents += local.documents;
+            report.convert.busy += local.busy;
+            report.convert.inputWait += local.inputWait;
+            report.convert.outputWait += local.outputWait;
+            report.convert.parserWait += local.parserWait;
+        });
+    }
+
+    //! Writer: writes finished documents in completion order
+    std::thread writer([&]() {
+        documentPtr document;
+        while (toWrite.pop(document, report.writer.inputWait)) {
+            auto start = std::chrono::steady_clock::now();
+            PROFILE_PHASE(PHASE_WRITE);
+            bool written = true;
+            for (auto& output : document->outputs) {
+                FILE* file = fopen(output.first.c_str(), "wb");
+                bool ok = file && fwrite(output.second.data(), 1, output.second.size(), file) == output.second.size();
+                if (file && fclose(file) != 0) ok = false;
+                if (!ok) {
+                    std::cerr << "Unable to write file: " << output.first << std::endl;
+                    written = false;
+                }
+            }
+            if (!written) {
+                std::lock_guard<std::mutex> guard(failedLock);
+                report.failed++;
+            } else {
+                report.writer.documents++;
+            }
+            report.writer.busy += secondsSince(start);
+        }
+    });
+
+    reader.join();
+    for (auto& worker : workers) worker.join();
+    toWrite.close();
+    writer.join();
+    report.recovered = recovered;
+    return report;
+}
+
+//! Prints the per-stage busy and stall times of a batch run
+void printPipelineReport(const pipelineReport& report, std::ostream& out) {
+    char line[160];
+    out << "stage\tdocs\tbusy_s\tinput_wait_s\toutput_wait_s\tparser_wait_s\n";
+    const stageStats* stages[] = { &report.reader, &report.convert, &report.writer };
+    const char* names[] = { "read", "convert", "write" };
+    for (int i = 0; i < 3; i++) {
+        snprintf(line, sizeof(line), "%s\t%zu\t%.3f\t%.3f\t%.3f\t%.3f\n", names[i], stages[i]->documents,
+                 stages[i]->busy, stages[i]->inputWait, stages[i]->outputWait, stages[i]->parserWait);
+        out << line;
+    }
+    if (report.recovered > 0) out << "recovered\t" << report.recovered << "\n";
+    if (report.failed > 0) out << "failed\t" << report.failed << "\n";
+}
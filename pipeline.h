@@ -0,0 +1,113 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "budget.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class bibDatabase;
+
+//! Blocking FIFO with a fixed capacity, used to hand documents from one pipeline stage to the next.
+//! push blocks while the queue is full and pop blocks while it is empty; both add the time spent
+//! blocked to `stalled` (in seconds) so the driver can report where the pipeline waits.
+template <typename T>
+class boundedQueue {
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+    std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+public:
+    explicit boundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), closed(false) {}
+
+    //! Adds an item, waiting for space; returns false if the queue was closed
+    bool push(T item, double& stalled) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (items.size() >= capacity && !closed) {
+            auto start = std::chrono::steady_clock::now();
+            notFull.wait(guard, [this]() { return items.size() < capacity || closed; });
+            stalled += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    //! Takes the oldest item, waiting for one; returns false once the queue is closed and drained
+    bool pop(T& item, double& stalled) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (items.empty() && !closed) {
+            auto start = std::chrono::steady_clock::now();
+            notEmpty.wait(guard, [this]() { return !items.empty() || closed; });
+            stalled += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    //! No more items will be pushed; wakes every waiting stage
+    void close() {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
+
+//! Settings of a batch run
+struct pipelineOptions {
+    size_t queueDepth;      //! Capacity of each queue between stages (documents in flight per stage boundary)
+    unsigned workers;       //! Number of conversion threads
+    bool mathTransform;     //! Same as --plain-math for a single document
+    bool html;              //! Also write <name>.html from the same traversal
+    bool json;              //! Also write <name>.json from the same traversal
+    const bibDatabase* bib; //! Bibliography for \cite, shared read-only by all workers (nullptr: none)
+    resourceLimits limits;  //! Budget of each document; documents over it are reported and counted as failed
+};
+
+//! Time accounting for one stage; worker times are summed over all conversion threads
+struct stageStats {
+    size_t documents;       //! Documents that went through the stage
+    double busy;            //! Seconds spent doing the stage's own work
+    double inputWait;       //! Seconds blocked waiting for the previous stage (empty queue)
+    double outputWait;      //! Seconds blocked waiting for the next stage (full queue)
+    double parserWait;      //! Seconds blocked waiting for the shared lexer/parser (conversion stage only)
+};
+
+//! Per-stage statistics of a batch run
+struct pipelineReport {
+    stageStats reader;
+    stageStats convert;
+    stageStats writer;
+    size_t recovered;       //! Documents converted despite syntax errors (the parts around the errors were skipped)
+    size_t failed;          //! Inputs that could not be read or parsed, documents over their budget, or outputs that could not be written
+};
+
+//! Reads the whole file into `buffer`, followed by the two NUL bytes the scanner needs.
+//! The buffer is scanned in place, so math and other passthrough spans point straight into it.
+bool readInput(const char* filename, std::vector<char>& buffer);
+
+//! Reports invalid UTF-8 in the input with byte offsets; the scanner drops these bytes
+void reportInvalidUtf8(const char* filename, const std::vector<char>& buffer);
+
+//! Converts every input into `outputDirectory`/<input name>.md (plus .html/.json if requested) with three overlapped stages:
+//! a reader that reads ahead, a pool of conversion workers and a writer, connected by bounded queues.
+pipelineReport runPipeline(const std::vector<std::string>& inputs, const std::string& outputDirectory,
+                           const pipelineOptions& options);
+
+//! Prints the per-stage busy and stall times of a batch run
+void printPipelineReport(const pipelineReport& report, std::ostream& out);
+
+#endif //! PIPELINE_H
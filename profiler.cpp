@@ -0,0 +1,171 @@
+#include "profiler.h"
+#include <cstdio>
+#include <sys/resource.h>
+
+#ifdef ALLOC_PROFILE
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+//! Every allocation is prefixed with a header recording its size, phase and node type,
+//! so that frees can be attributed back to where the memory was allocated
+struct allocHeader {
+    size_t size;
+    int phase;
+    int nodeType;
+};
+
+static const size_t HEADER_SIZE = 16;  //! Keeps the returned pointer 16-byte aligned
+static_assert(sizeof(allocHeader) <= HEADER_SIZE, "allocation header does not fit");
+
+//! Counters for one row of the report; zero-initialized before any static constructor runs
+struct allocCounters {
+    std::atomic<long long> count;
+    std::atomic<long long> bytes;
+    std::atomic<long long> live;
+    std::atomic<long long> peak;
+};
+
+static allocCounters phaseCounters[PHASE_COUNT];
+static allocCounters nodeCounters[NODE_TYPE_COUNT];
+static allocCounters totalCounters;
+
+static thread_local int currentPhase = PHASE_NONE;
+static thread_local int currentNodeType = -1;
+
+static const char* phaseToString(int phase) {
+    switch (phase) {
+        case PHASE_NONE: return "none";
+        case PHASE_LEX: return "lex";
+        case PHASE_PARSE: return "parse";
+        case PHASE_CONVERT: return "convert";
+        case PHASE_WRITE: return "write";
+        default: return "unknown";
+    }
+}
+
+//! Raises `peak` to `value` if it is larger
+static void updatePeak(std::atomic<long long>& peak, long long value) {
+    long long seen = peak.load(std::memory_order_relaxed);
+    while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+static void recordAlloc(allocCounters& c, size_t size) {
+    c.count.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add(size, std::memory_order_relaxed);
+    updatePeak(c.peak, c.live.fetch_add(size, std::memory_order_relaxed) + size);
+}
+
+static void recordFree(allocCounters& c, size_t size) {
+    c.live.fetch_sub(size, std::memory_order_relaxed);
+}
+
+static void* profiledAlloc(size_t size) {
+    char* block = static_cast<char*>(std::malloc(size + HEADER_SIZE));
+    if (!block) return nullptr;
+    allocHeader* header = reinterpret_cast<allocHeader*>(block);
+    header->size = size;
+    header->phase = currentPhase;
+    header->nodeType = currentNodeType;
+    recordAlloc(totalCounters, size);
+    recordAlloc(phaseCounters[currentPhase], size);
+    if (currentNodeType >= 0) recordAlloc(nodeCounters[currentNodeType], size);
+    return block + HEADER_SIZE;
+}
+
+static void profiledFree(void* ptr) {
+    if (!ptr) return;
+    char* block = static_cast<char*>(ptr) - HEADER_SIZE;
+    allocHeader* header = reinterpret_cast<allocHeader*>(block);
+    recordFree(totalCounters, header->size);
+    recordFree(phaseCounters[header->phase], header->size);
+    if (header->nodeType >= 0) recordFree(nodeCounters[header->nodeType], header->size);
+    std::free(block);
+}
+
+void* operator new(size_t size) {
+    void* ptr = profiledAlloc(size);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    void* ptr = profiledAlloc(size);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return profiledAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return profiledAlloc(size); }
+
+void operator delete(void* ptr) noexcept { profiledFree(ptr); }
+void operator delete[](void* ptr) noexcept { profiledFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { profiledFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { profiledFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { profiledFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { profiledFree(ptr); }
+
+phaseScope::phaseScope(ProfilePhase phase) : previous(static_cast<ProfilePhase>(currentPhase)) {
+    currentPhase = phase;
+}
+
+phaseScope::~phaseScope() {
+    currentPhase = previous;
+}
+
+nodeTypeScope::nodeTypeScope(NodeType type) : previous(currentNodeType) {
+    currentNodeType = type;
+}
+
+nodeTypeScope::~nodeTypeScope() {
+    currentNodeType = previous;
+}
+
+static void writeRow(std::ofstream& file, const std::string& name, const allocCounters& c) {
+    file << name << "\t" << c.count.load() << "\t" << c.bytes.load() << "\t" << c.peak.load() << "\t" << c.live.load() << "\n";
+}
+
+//! Writes the per-phase and per-NodeType allocation report to the given file
+void writeAllocReport(const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Unable to open file: " << filename << std::endl;
+        return;
+    }
+    file << "phase\tallocs\tbytes\tpeak_live_bytes\tlive_bytes\n";
+    for (int phase = PHASE_NONE; phase < PHASE_COUNT; phase++) {
+        writeRow(file, phaseToString(phase), phaseCounters[phase]);
+    }
+    writeRow(file, "total", totalCounters);
+
+    file << "\nnode_type\tallocs\tbytes\tpeak_live_bytes\tlive_bytes\n";
+    for (int type = 0; type < NODE_TYPE_COUNT; type++) {
+        if (nodeCounters[type].count.load() == 0) continue;
+        writeRow(file, nodeTypeToString(static_cast<NodeType>(type)), nodeCounters[type]);
+    }
+}
+
+#endif //! ALLOC_PROFILE
+
+//! Peak resident set size of the process so far, in KiB
+size_t peakResidentKB() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  //! Reported in bytes on macOS, in KiB on Linux
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+//! Prints the size of a conversion, its wall time, throughput and the peak RSS as "name\tvalue" lines (--stats)
+void printRunStats(std::ostream& out, size_t bytes, double seconds) {
+    char line[128];
+    snprintf(line, sizeof(line), "bytes\t%zu\nseconds\t%.6f\nthroughput_mb_s\t%.3f\npeak_rss_kb\t%zu\n",
+             bytes, seconds, seconds > 0 ? bytes / seconds / 1e6 : 0.0, peakResidentKB());
+    out << line;
+    out.flush();
+}
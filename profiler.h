@@ -0,0 +1,58 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "ast.h"
+#include <ostream>
+#include <string>
+
+//! Conversion phases that allocations are attributed to
+enum ProfilePhase {
+    PHASE_NONE,           //! Outside of any conversion phase (startup, argument handling)
+    PHASE_LEX,            //! Inside yylex
+    PHASE_PARSE,          //! Inside yyparse, excluding the nested yylex calls
+    PHASE_CONVERT,        //! AST to Markdown traversal
+    PHASE_WRITE,          //! Writing the output file(s)
+    PHASE_COUNT
+};
+
+//! Allocation accounting is only compiled in when ALLOC_PROFILE is defined
+//! (cmake -DALLOC_PROFILE=ON). In normal builds the macros below expand to nothing
+//! and the global operator new/delete are left untouched.
+#ifdef ALLOC_PROFILE
+
+//! Sets the current thread's phase for its lifetime and restores the previous one on exit
+class phaseScope {
+    ProfilePhase previous;
+public:
+    explicit phaseScope(ProfilePhase phase);
+    ~phaseScope();
+};
+
+//! Attributes allocations to a NodeType for its lifetime (node creation, node conversion)
+class nodeTypeScope {
+    int previous;
+public:
+    explicit nodeTypeScope(NodeType type);
+    ~nodeTypeScope();
+};
+
+//! Writes the per-phase and per-NodeType allocation report to the given file
+void writeAllocReport(const std::string& filename);
+
+#define PROFILE_PHASE(phase) phaseScope profilePhase_(phase)
+#define PROFILE_NODE(type) nodeTypeScope profileNode_(type)
+
+#else
+
+#define PROFILE_PHASE(phase)
+#define PROFILE_NODE(type)
+
+#endif //! ALLOC_PROFILE
+
+//! Peak resident set size of the process so far, in KiB
+size_t peakResidentKB();
+
+//! Prints the size of a conversion, its wall time, throughput and the peak RSS as "name\tvalue" lines (--stats)
+void printRunStats(std::ostream& out, size_t bytes, double seconds);
+
+#endif //! PROFILER_H
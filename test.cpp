@@ -1,11 +1,24 @@
 #include <iostream>
 #include <string>
+#include <cstring>
 #include "gtest/gtest.h"
 #include "converter.h"
 #include "ast.h"
+#include "utf8.h"
+#include "escape.h"
+#include "pipeline.h"
+#include "emitter.h"
+#include "macro.h"
+#include "bib.h"
+#include "budget.h"
+#include "parse.h"
+#include <cstdio>
+#include <thread>
 
 using namespace std;
 
+ASTManager astManager;  //! Used by the parser's actions; the program defines it in main.cpp
+
 class LatexToMdTest : public ::testing::Test {
 protected:
     ASTManager astManager; 
@@ -122,11 +135,18 @@ protected:
         return root;
     }
 
+    ASTNode* createMathAST(NodeType type, const char* body) {
+        ASTNode* root = astManager.newNode(type);
+        root->span.ptr = body;
+        root->span.len = strlen(body);
+        return root;
+    }
+
 };
 
 TEST_F(LatexToMdTest, ConvertsSectionToMarkdown) {
     ASTNode* root = createSectionAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
 
     std::string expectedMarkdown = "## 1 Introduction\n\n\n\n";
 
@@ -135,16 +155,16 @@ TEST_F(LatexToMdTest, ConvertsSectionToMarkdown) {
 
 TEST_F(LatexToMdTest, ConvertsSubsectionToMarkdown) {
     ASTNode* root = createSubsectionAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
 
-    std::string expectedMarkdown = "### 1.1 Subsection Example\n\n\n\n";
+    std::string expectedMarkdown = "### 0.1 Subsection Example\n\n\n\n";
 
     EXPECT_EQ(markdownOutput, expectedMarkdown);
 }
 
 TEST_F(LatexToMdTest, ConvertsTextToMarkdown) {
     ASTNode* root = createTextAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
 
     std::string expectedMarkdown = "This is a sample text.";
 
@@ -153,7 +173,7 @@ TEST_F(LatexToMdTest, ConvertsTextToMarkdown) {
 
 TEST_F(LatexToMdTest, ConvertsBoldToMarkdown) {
     ASTNode* root = createBoldAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
 
     std::string expectedMarkdown = "**bold** ";
 
@@ -162,7 +182,7 @@ TEST_F(LatexToMdTest, ConvertsBoldToMarkdown) {
 
 TEST_F(LatexToMdTest, ConvertsItalicToMarkdown) {
     ASTNode* root = createItalicAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
 
     std::string expectedMarkdown = "*italic* ";
 
@@ -171,7 +191,7 @@ TEST_F(LatexToMdTest, ConvertsItalicToMarkdown) {
 
 TEST_F(LatexToMdTest, ConvertsItemizeToMarkdown) {
     ASTNode* root = createItemizeAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
 
     std::string expectedMarkdown = "\n-First item\n-Second item\n\n";
 
@@ -180,7 +200,7 @@ TEST_F(LatexToMdTest, ConvertsItemizeToMarkdown) {
 
 TEST_F(LatexToMdTest, ConvertsTabularToMarkdown) {
     ASTNode* root = createTabularAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
 
     std::string expectedMarkdown = R"(
 | Header1  | Header2  |
@@ -191,14 +211,14 @@ TEST_F(LatexToMdTest, ConvertsTabularToMarkdown) {
 
 TEST_F(LatexToMdTest, ConvertsVerbatimToMarkdown) {
     ASTNode* root = createVerbatimAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
     std::string expectedMarkdown = "\n\n```\nThis is verbatim text.\n```\n\n";
     EXPECT_EQ(markdownOutput, expectedMarkdown);
 }
 
 TEST_F(LatexToMdTest, ConvertsParToMarkdown) {
     ASTNode* root = createParAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
 
     std::string expectedMarkdown = "This is a paragraph. \n\n This is another paragraph.";
 
@@ -207,7 +227,7 @@ TEST_F(LatexToMdTest, ConvertsParToMarkdown) {
 
 TEST_F(LatexToMdTest, ConvertsFigureToMarkdown) {
     ASTNode* root = createFigureAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
 
     std::string expectedMarkdown = "![](This is a figure caption.)\n\n";
 
@@ -216,13 +236,748 @@ TEST_F(LatexToMdTest, ConvertsFigureToMarkdown) {
 
 TEST_F(LatexToMdTest, ConvertsHrefToMarkdown) {
     ASTNode* root = createHrefAST();
-    std::string markdownOutput = c.traversal(root);
+    std::string markdownOutput = c.convert(root);
 
     std::string expectedMarkdown = "[Example](http://example.com) \n";
 
     EXPECT_EQ(markdownOutput, expectedMarkdown);
 }
 
+TEST_F(LatexToMdTest, PassesInlineMathThrough) {
+    ASTNode* root = createMathAST(MATH_H, "x^2 + \\frac{1}{2}");
+    std::string markdownOutput = c.convert(root);
+
+    std::string expectedMarkdown = "$x^2 + \\frac{1}{2}$ ";
+
+    EXPECT_EQ(markdownOutput, expectedMarkdown);
+}
+
+TEST_F(LatexToMdTest, PassesDisplayMathThrough) {
+    ASTNode* root = createMathAST(DISPLAY_MATH_H, "E = mc^2");
+    std::string markdownOutput = c.convert(root);
+
+    std::string expectedMarkdown = "\n\n$$\nE = mc^2\n$$\n\n";
+
+    EXPECT_EQ(markdownOutput, expectedMarkdown);
+}
+
+TEST_F(LatexToMdTest, TransformsSqrtInMath) {
+    ASTNode* root = createMathAST(MATH_H, "\\sqrt{a + \\sqrt[3]{b}} = c");
+    c.setMathTransform(true);
+    std::string markdownOutput = c.convert(root);
+
+    std::string expectedMarkdown = "√(a + 3√(b)) = c ";
+
+    EXPECT_EQ(markdownOutput, expectedMarkdown);
+}
+
+TEST_F(LatexToMdTest, KeepsTransformedMathWithinBudget) {
+    std::string nested;
+    for (int i = 0; i < 100000; i++) nested += "\\sqrt{";
+    ASTNode* deep = createMathAST(MATH_H, nested.c_str());
+    c.setMathTransform(true);
+
+    resourceLimits shallow = { 0, 100, 0, 0 };
+    beginBudget(shallow);
+    EXPECT_THROW(c.convert(deep), budgetExceeded);
+    endBudget();
+
+    std::string wide;
+    for (int i = 0; i < 100; i++) wide += "\\sqrt x + ";
+    ASTNode* many = createMathAST(MATH_H, wide.c_str());
+    resourceLimits few = { 50, 0, 0, 0 };
+    beginBudget(few);
+    try {
+        c.convert(many);
+        FAIL() << "node limit not enforced";
+    } catch (const budgetExceeded& e) {
+        EXPECT_STREQ(e.what(), "node limit of 50 exceeded");
+    }
+    endBudget();
+    delete deep;
+    delete many;
+}
+
+TEST_F(LatexToMdTest, ResolvesBackwardReference) {
+    ASTNode* root = astManager.newNode(DOCUMENT_H);
+    ASTNode* section = createSectionAST();
+    ASTNode* label = astManager.newNode(LABEL_H);
+    label->data = "sec:intro";
+    ASTNode* ref = astManager.newNode(REF_H);
+    ref->data = "sec:intro";
+    root->addChild(section);
+    root->addChild(label);
+    root->addChild(ref);
+    std::string markdownOutput = c.convert(root);
+
+    std::string expectedMarkdown = "## 1 Introduction\n\n\n\n<a id=\"sec:intro\"></a>\n\n[1](#sec:intro)";
+
+    EXPECT_EQ(markdownOutput, expectedMarkdown);
+}
+
+TEST_F(LatexToMdTest, BackPatchesForwardReferences) {
+    ASTNode* root = astManager.newNode(DOCUMENT_H);
+    ASTNode* ref = astManager.newNode(REF_H);
+    ref->data = "fig:logo";
+    ASTNode* missing = astManager.newNode(REF_H);
+    missing->data = "fig:missing";
+    ASTNode* figure = createFigureAST();
+    ASTNode* label = astManager.newNode(LABEL_H);
+    label->data = "fig:logo";
+    figure->addChild(label);
+    root->addChild(ref);
+    root->addChild(missing);
+    root->addChild(figure);
+    std::string markdownOutput = c.convert(root);
+
+    std::string expectedMarkdown = "[1](#fig:logo)" "??" "<a id=\"fig:logo\"></a>\n\n![](This is a figure caption.)\n\n";
+
+    EXPECT_EQ(markdownOutput, expectedMarkdown);
+}
+
+TEST_F(LatexToMdTest, SplitsTopLevelSectionsIntoFiles) {
+    ASTNode* root = astManager.newNode(DOCUMENT_H);
+    ASTNode* title = astManager.newNode(TITLE_H);
+    title->data = "Handbook";
+    ASTNode* content = astManager.newNode(DOCUMENT_H);
+    ASTNode* first = astManager.newNode(SECTION_H);
+    first->data = "Getting Started";
+    ASTNode* sub = astManager.newNode(SUBSECTION_H);
+    sub->data = "Install";
+    ASTNode* ref = astManager.newNode(REF_H);
+    ref->data = "sec:faq";
+    ASTNode* second = astManager.newNode(SECTION_H);
+    second->data = "FAQ";
+    ASTNode* label = astManager.newNode(LABEL_H);
+    label->data = "sec:faq";
+    root->addChild(title);
+    root->addChild(content);
+    content->addChild(first);
+    content->addChild(sub);
+    content->addChild(ref);
+    content->addChild(second);
+    content->addChild(label);
+
+    std::vector<sectionChunk> chunks = c.splitSections(root);
+
+    ASSERT_EQ(chunks.size(), 3u);
+    EXPECT_EQ(chunks[0].file, "index.md");
+    EXPECT_EQ(chunks[0].markdown, "# Handbook\n\n");
+    EXPECT_EQ(chunks[1].file, "01-getting-started.md");
+    EXPECT_EQ(chunks[1].markdown, "## 1 Getting Started\n\n\n\n### 1.1 Install\n\n\n\n[2](02-faq.md#sec:faq)");
+    EXPECT_EQ(chunks[2].file, "02-faq.md");
+    EXPECT_EQ(c.tableOfContents(), "## Contents\n\n"
+                                   "- [1 Getting Started](01-getting-started.md)\n"
+                                   "  - [1.1 Install](01-getting-started.md#11-install)\n"
+                                   "- [2 FAQ](02-faq.md)\n");
+}
+
+TEST(Utf8Test, AcceptsMultiByteText) {
+    std::string text = "Caf\xC3\xA9 na\xC3\xAFve \xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E \xF0\x9F\x98\x80 plus a long ASCII tail";
+
+    EXPECT_TRUE(validateUtf8(text.data(), text.size()).empty());
+}
+
+TEST(Utf8Test, ReportsInvalidSequencesWithOffsets) {
+    //! Stray continuation byte, overlong '/', surrogate, truncated sequence at the end
+    std::string text = "abc\x80 def \xC0\xAF \xED\xA0\x80 \xE6\x97";
+    std::vector<size_t> invalid = validateUtf8(text.data(), text.size());
+
+    std::vector<size_t> expected = {3, 9, 10, 12, 13, 14, 16, 17};
+    EXPECT_EQ(invalid, expected);
+}
+
+TEST(Utf8Test, ReportsInvalidSequencesInsideLongMultiByteText) {
+    //! Long enough for the block check; each error is found at its offset by the sequence-by-sequence walk
+    std::string unit = "\xE6\x97\xA5\xE0\xA4\xB9\xED\x9F\xBF\xF4\x8F\xBF\xBF \xC3\xA9";
+    std::string text;
+    for (int i = 0; i < 40; i++) text += unit;
+    EXPECT_TRUE(validateUtf8(text.data(), text.size()).empty());
+
+    text[109] = '\xC1';         //! Overlong lead
+    text.insert(301, "\x80");   //! Stray continuation
+    text[500] = 'x';            //! Replaces a lead, leaving its two continuations stray
+    std::vector<size_t> invalid = validateUtf8(text.data(), text.size());
+
+    std::vector<size_t> expected = {109, 301, 501, 502};
+    EXPECT_EQ(invalid, expected);
+}
+
+TEST(Utf8Test, FindsEndOfAsciiPrefix) {
+    std::string text = std::string(37, 'a') + "\xC3\xA9";
+
+    EXPECT_EQ(asciiPrefix(text.data(), text.size()), 37u);
+    EXPECT_EQ(asciiPrefix(text.data(), 20), 20u);
+}
+
+TEST(EscapeTest, EscapesSpecialsPerContext) {
+    EXPECT_EQ(escapeMarkdown("a*b_c `d` #1 | x", ESCAPE_PARAGRAPH), "a\\*b\\_c \\`d\\` #1 | x");
+    EXPECT_EQ(escapeMarkdown("#1 | x", ESCAPE_HEADING), "\\#1 | x");
+    EXPECT_EQ(escapeMarkdown("#1 | x", ESCAPE_TABLE_CELL), "#1 \\| x");
+}
+
+TEST(EscapeTest, EscapesBlockMarkersAtLineStarts) {
+    EXPECT_EQ(escapeMarkdown("#1 is first", ESCAPE_PARAGRAPH), "\\#1 is first");
+    EXPECT_EQ(escapeMarkdown("a\n  > quoted", ESCAPE_PARAGRAPH), "a\n  \\> quoted");
+    EXPECT_EQ(escapeMarkdown("- a\n+ b", ESCAPE_LIST_ITEM), "\\- a\n\\+ b");
+    EXPECT_EQ(escapeMarkdown("1. one\n2) two\n3.14 and 1999.", ESCAPE_PARAGRAPH), "1\\. one\n2\\) two\n3.14 and 1999.");
+    //! Only at the start of a line, and not in headings or table cells, which never start one
+    EXPECT_EQ(escapeMarkdown("a # b > c - d", ESCAPE_PARAGRAPH), "a # b > c - d");
+    EXPECT_EQ(escapeMarkdown("- a", ESCAPE_TABLE_CELL), "- a");
+    std::string clean(70, 'a');
+    EXPECT_EQ(escapeMarkdown(clean + "\n# b", ESCAPE_PARAGRAPH), clean + "\n\\# b");
+
+    std::string out = "text ";
+    appendEscaped(out, "- more", 6, ESCAPE_PARAGRAPH);
+    EXPECT_EQ(out, "text - more");
+    out = "text\n";
+    appendEscaped(out, "- more", 6, ESCAPE_PARAGRAPH);
+    EXPECT_EQ(out, "text\n\\- more");
+    //! Text right after a list marker starts the item's line
+    out = "\n\t1.";
+    appendEscaped(out, "# more", 6, ESCAPE_LIST_ITEM);
+    EXPECT_EQ(out, "\n\t1.\\# more");
+    out = "**";
+    appendEscaped(out, "- more", 6, ESCAPE_PARAGRAPH);
+    EXPECT_EQ(out, "**- more");
+}
+
+TEST(EscapeTest, CopiesCleanRunsAroundSpecials) {
+    std::string clean(70, 'a');
+    std::string text = clean + "[" + clean + "]";
+
+    EXPECT_EQ(escapeMarkdown(clean, ESCAPE_PARAGRAPH), clean);
+    EXPECT_EQ(escapeMarkdown(text, ESCAPE_PARAGRAPH), clean + "\\[" + clean + "\\]");
+
+    //! Every position of the unrolled scan, and past the copy window
+    for (size_t at : {0, 15, 16, 31, 63, 64, 100, 127, 8191, 8192, 8200}) {
+        std::string line(9000, 'a');
+        line[at] = '|';
+        std::string expected = line;
+        expected.insert(at, "\\");
+        EXPECT_EQ(escapeMarkdown(line, ESCAPE_TABLE_CELL), expected) << at;
+        EXPECT_EQ(escapeMarkdown(line, ESCAPE_PARAGRAPH), line) << at;
+    }
+}
+
+TEST_F(LatexToMdTest, EscapesTextInsideFormatting) {
+    ASTNode* root = createBoldAST();
+    root->data = "2*3_4";
+    std::string markdownOutput = c.convert(root);
+
+    std::string expectedMarkdown = "**2\\*3\\_4** ";
+
+    EXPECT_EQ(markdownOutput, expectedMarkdown);
+}
+
+TEST_F(LatexToMdTest, KeepsTextOfParagraphAfterFormatting) {
+    ASTNode* root = astManager.newNode(STRING_H);
+    root->data = "First paragraph.";
+    root->addChild(createBoldAST());
+    ASTNode* text = astManager.newNode(STRING_H);
+    text->data = "Second paragraph, merged from two lines.";
+    text->addChild(createItalicAST());
+    ASTNode* par = astManager.newNode(PAR_H);
+    par->addChild(text);
+    root->addChild(par);
+    std::string markdownOutput = c.convert(root);
+
+    std::string expectedMarkdown = "First paragraph. **bold**  \n\n Second paragraph, merged from two lines. *italic* ";
+
+    EXPECT_EQ(markdownOutput, expectedMarkdown);
+}
+
+TEST(PipelineTest, BoundedQueueBlocksProducerAtCapacity) {
+    boundedQueue<int> queue(2);
+    double producerStall = 0, consumerStall = 0;
+    std::thread producer([&]() {
+        for (int i = 0; i < 100; i++) queue.push(i, producerStall);
+        queue.close();
+    });
+
+    std::vector<int> received;
+    int item;
+    while (queue.pop(item, consumerStall)) received.push_back(item);
+    producer.join();
+
+    ASSERT_EQ(received.size(), 100u);
+    for (int i = 0; i < 100; i++) EXPECT_EQ(received[i], i);
+    EXPECT_FALSE(queue.push(100, producerStall));
+}
+
+TEST_F(LatexToMdTest, EmitsAllFormatsFromOneTraversal) {
+    ASTNode* content = astManager.newNode(DOCUMENT_H);
+    ASTNode* text = astManager.newNode(STRING_H);
+    text->data = "See";
+    ASTNode* ref = astManager.newNode(REF_H);
+    ref->data = "sec:a";
+    text->addChild(ref);
+    content->addChild(text);
+    ASTNode* section = astManager.newNode(SECTION_H);
+    section->data = "A & B";
+    content->addChild(section);
+    ASTNode* label = astManager.newNode(LABEL_H);
+    label->data = "sec:a";
+    content->addChild(label);
+    ASTNode* root = astManager.newNode(DOCUMENT_H);
+    root->addChild(content);
+
+    converter direct;
+    std::string expectedMarkdown = direct.convert(root);
+
+    markdownEmitter markdown(c);
+    htmlEmitter html;
+    jsonEmitter json;
+    emitDocument(root, {&markdown, &html, &json});
+
+    EXPECT_EQ(markdown.output(), expectedMarkdown);
+    EXPECT_NE(html.output().find("<p>See <a href=\"#sec:a\">1</a> </p>\n<h2>1 A &amp; B</h2>\n<a id=\"sec:a\"></a>"), std::string::npos);
+    EXPECT_EQ(json.output(), "{\"type\":\"DOCUMENT_H\",\"children\":[{\"type\":\"DOCUMENT_H\",\"children\":["
+                             "{\"type\":\"STRING_H\",\"text\":\"See\",\"children\":[{\"type\":\"REF_H\",\"text\":\"sec:a\"}]},"
+                             "{\"type\":\"SECTION_H\",\"number\":\"1\",\"text\":\"A & B\"},"
+                             "{\"type\":\"LABEL_H\",\"text\":\"sec:a\"}]}]}\n");
+}
+
+static std::string expandAll(const std::string& text) {
+    macroExpander expander;
+    return expander.expand(text.data(), text.size());
+}
+
+TEST(MacroTest, ExpandsParameterizedMacros) {
+    EXPECT_EQ(expandAll("\\newcommand{\\pair}[2]{(#1, #2)}\\pair{a}{b} \\pair x y"), "(a, b) (x, y)");
+    EXPECT_EQ(expandAll("\\newcommand{\\greet}[2][Hello]{#1, #2!}\\greet{Bob} \\greet[Hi]{Ann}"), "Hello, Bob! Hi, Ann!");
+    EXPECT_EQ(expandAll("\\def\\bold#1{\\textbf{#1}}\\bold{x}"), "\\textbf{x}");
+}
+
+TEST(MacroTest, CachesArgumentFreeMacrosUntilRedefined) {
+    macroExpander expander;
+    std::string text = "\\newcommand\\x{1}\\newcommand\\y{\\x\\x}\\y\\y\\renewcommand\\x{2}\\y";
+
+    EXPECT_EQ(expander.expand(text.data(), text.size()), "111122");
+    EXPECT_EQ(expander.cacheHits(), 3u);
+}
+
+TEST(MacroTest, LeavesCommentsAndVerbatimAlone) {
+    std::string text = "\\newcommand{\\x}{X}\\x % \\x\n\\begin{verbatim}\\x\\end{verbatim} \\\\x";
+
+    EXPECT_EQ(expandAll(text), "X% \\x\n\\begin{verbatim}\\x\\end{verbatim} \\\\x");
+    EXPECT_FALSE(macroExpander::hasDefinitions("\\default \\section{A}", 20));
+}
+
+TEST(MacroTest, StopsRunawayRecursion) {
+    macroExpander expander;
+    std::string text = "\\def\\a{\\a}\\a";
+
+    EXPECT_EQ(expander.expand(text.data(), text.size()), "\\a");
+    EXPECT_EQ(expander.warnings().size(), 1u);
+}
+
+TEST(MacroTest, StopsExponentialGrowth) {
+    //! Each level doubles the expansion; unchecked it would ask for about 2^63 bytes
+    for (std::string text : { std::string("\\def\\a{\\a\\a}\\a"),
+                              std::string("\\newcommand{\\b}[1]{\\b{#1#1}}\\b{x}") }) {
+        macroExpander expander;
+        std::string expanded = expander.expand(text.data(), text.size());
+
+        EXPECT_LE(expanded.size(), 64u * 1024u);
+        ASSERT_FALSE(expander.warnings().empty());
+        EXPECT_NE(expander.warnings().back().find("macro expansion exceeds"), std::string::npos) << text;
+    }
+}
+
+TEST(BibTest, IndexesEntriesAndParsesFieldsOnLookup) {
+    char path[] = "/tmp/bibtest-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    const char* text =
+        "@comment{knuth, ignored}\n"
+        "@string{tug = \"TUGboat\"}\n"
+        "@Article{knuth,\n  Author = {Donald E. Knuth},\n  title = {Literate {P}rogramming},\n"
+        "  journal = \"The Computer \" # \"Journal\",\n  year = 1984\n}\n"
+        "@book(lamport, author = {Leslie Lamport}, title = {{\\LaTeX}: A Document\n   Preparation System})\n";
+    FILE* file = fdopen(fd, "w");
+    fputs(text, file);
+    fclose(file);
+
+    bibDatabase bib;
+    ASSERT_TRUE(bib.open(path));
+    remove(path);  //! The mapping stays valid after the file is unlinked
+    EXPECT_EQ(bib.entries(), 2u);
+
+    bibEntry entry;
+    ASSERT_TRUE(bib.lookup("knuth", entry));
+    EXPECT_EQ(entry.type, "article");
+    EXPECT_EQ(entry.field("author"), "Donald E. Knuth");
+    EXPECT_EQ(entry.field("title"), "Literate Programming");
+    EXPECT_EQ(entry.venue(), "The Computer Journal");
+    EXPECT_EQ(entry.field("year"), "1984");
+    ASSERT_TRUE(bib.lookup("lamport", entry));
+    EXPECT_EQ(entry.field("title"), "\\LaTeX: A Document Preparation System");
+    EXPECT_FALSE(bib.lookup("missing", entry));
+}
+
+//! Writes `text` to a temporary .bib file and returns its path
+static std::string writeBib(const char* text) {
+    char path[] = "/tmp/bibtest-XXXXXX";
+    int fd = mkstemp(path);
+    FILE* file = fdopen(fd, "w");
+    fputs(text, file);
+    fclose(file);
+    return path;
+}
+
+TEST(BibTest, SkipsUnclosedEntriesAndKeepsIndexing) {
+    std::string path = writeBib(
+        "@article{first, title = {One}}\n"
+        "@article{broken, title = {Two},\n  note = {never closed\n"
+        "@book{after, title = {Three}}\n"
+        "  @misc(last, title = {Four})\n");
+    bibDatabase bib;
+    ASSERT_TRUE(bib.open(path));
+    remove(path.c_str());
+
+    EXPECT_EQ(bib.entries(), 3u);
+    bibEntry entry;
+    EXPECT_FALSE(bib.lookup("broken", entry));
+    ASSERT_TRUE(bib.lookup("after", entry));
+    EXPECT_EQ(entry.field("title"), "Three");
+    EXPECT_TRUE(bib.lookup("last", entry));
+    ASSERT_EQ(bib.warnings().size(), 1u);
+    EXPECT_EQ(bib.warnings()[0], "line 2: @article{broken is not closed, skipped");
+}
+
+TEST(BibTest, OpeningAgainReplacesTheEntries) {
+    std::string first = writeBib("@article{a, title = {A}}\n");
+    std::string second = writeBib("@article{b, title = {B}}\n@article{c, title = {C\n");
+    bibDatabase bib;
+    ASSERT_TRUE(bib.open(first));
+    ASSERT_TRUE(bib.open(second));
+    bibEntry entry;
+    EXPECT_EQ(bib.entries(), 1u);
+    EXPECT_FALSE(bib.lookup("a", entry));
+    EXPECT_TRUE(bib.lookup("b", entry));
+    EXPECT_EQ(bib.warnings().size(), 1u);
+
+    EXPECT_FALSE(bib.open("/nonexistent/refs.bib"));
+    EXPECT_EQ(bib.entries(), 0u);
+    EXPECT_TRUE(bib.warnings().empty());
+    remove(first.c_str());
+    remove(second.c_str());
+}
+
+TEST_F(LatexToMdTest, NumbersCitationsInOrderAndListsReferences) {
+    ASTNode* text = astManager.newNode(STRING_H);
+    text->data = "As shown";
+    ASTNode* first = astManager.newNode(CITE_H);
+    first->data = "b,a";
+    text->addChild(first);
+    ASTNode* again = astManager.newNode(CITE_H);
+    again->data = "a";
+    text->addChild(again);
+    ASTNode* root = astManager.newNode(DOCUMENT_H);
+    root->addChild(text);
+
+    std::string result = c.convert(root);
+    EXPECT_NE(result.find("As shown [[1](#ref-b), [2](#ref-a)]  [[2](#ref-a)]"), std::string::npos);
+    EXPECT_NE(result.find("## References\n\n1. <a id=\"ref-b\"></a>b\n2. <a id=\"ref-a\"></a>a\n"), std::string::npos);
+
+    htmlEmitter html;
+    emitDocument(root, {&html});
+    EXPECT_NE(html.output().find("<ol>\n<li id=\"ref-b\">b</li>\n<li id=\"ref-a\">a</li>\n</ol>"), std::string::npos);
+}
+
+TEST(BudgetTest, CountsNodesWithoutThrowingAndReportsTheLimit) {
+    resourceLimits limits = { 3, 0, 0, 0 };
+    beginBudget(limits);
+    ASTManager manager;
+    std::vector<ASTNode*> nodes;
+    for (int i = 0; i < 3; i++) nodes.push_back(manager.newNode(STRING_H));
+    EXPECT_EQ(budgetFailure(), "");
+    EXPECT_FALSE(budgetTick());
+    nodes.push_back(manager.newNode(STRING_H));
+    EXPECT_EQ(budgetFailure(), "node limit of 3 exceeded");
+    EXPECT_TRUE(budgetTick());
+    EXPECT_THROW(checkBudget(), budgetExceeded);
+    endBudget();
+    EXPECT_NO_THROW(checkBudget());
+    for (auto node : nodes) delete node;
+}
+
+TEST_F(LatexToMdTest, AbortsConversionOverDepthOrOutputBudget) {
+    ASTNode* root = astManager.newNode(DOCUMENT_H);
+    ASTNode* list = root;
+    for (int i = 0; i < 50; i++) {
+        ASTNode* item = astManager.newNode(TEXT_H);
+        list->addChild(item);
+        list = item;
+    }
+    ASTNode* text = astManager.newNode(STRING_H);
+    text->data = std::string(200, 'x');
+    list->addChild(text);
+
+    resourceLimits deep = { 0, 20, 0, 0 };
+    beginBudget(deep);
+    try {
+        c.convert(root);
+        FAIL() << "depth limit not enforced";
+    } catch (const budgetExceeded& e) {
+        EXPECT_STREQ(e.what(), "nesting depth limit of 20 exceeded");
+    }
+    endBudget();
+
+    resourceLimits small = { 0, 0, 100, 0 };
+    beginBudget(small);
+    EXPECT_THROW(c.convert(root), budgetExceeded);
+    endBudget();
+
+    EXPECT_EQ(c.convert(root), std::string(200, 'x'));
+}
+
+TEST_F(LatexToMdTest, SkipsEnvironmentsLeftEmptyBySyntaxErrors) {
+    //! Error recovery in the parser keeps a malformed list or table as a node without children
+    ASTNode* root = astManager.newNode(DOCUMENT_H);
+    root->addChild(astManager.newNode(ITEMIZE_H));
+    root->addChild(astManager.newNode(TABULAR_H));
+    ASTNode* text = astManager.newNode(STRING_H);
+    text->data = "after";
+    root->addChild(text);
+
+    EXPECT_EQ(c.convert(root), "after");
+}
+
+TEST(MacroTest, KeepsLineNumbersOfRemovedDefinitions) {
+    EXPECT_EQ(expandAll("\\newcommand{\\x}{\nX\n}\n\\x"), "\n\n\n\nX\n");
+}
+
+TEST(MacroTest, MapsExpandedLinesToSourceLines) {
+    macroExpander expander;
+    std::string text = "\\newcommand{\\x}{\nX\n}\n\\x\nY";
+    std::string expanded = expander.expand(text.data(), text.size());
+    EXPECT_EQ(expanded, "\n\n\n\nX\n\nY");
+    EXPECT_EQ(expander.sourceLines(expanded), std::vector<int>({1, 2, 3, 4, 4, 4, 5}));
+
+    //! A use whose argument spans lines: the text after it is on the line where the use ends
+    text = "\\newcommand{\\p}[1]{(#1)}\\p{a\nb}\nZ";
+    expanded = expander.expand(text.data(), text.size());
+    EXPECT_EQ(expanded, "(a\nb)\nZ");
+    EXPECT_EQ(expander.sourceLines(expanded), std::vector<int>({1, 2, 3}));
+}
+
+//! Runs the scanner and parser over `text`; the tree points into `buffer`, which must outlive it
+static parseResult parseSource(const std::string& text, std::vector<char>& buffer) {
+    buffer.assign(text.begin(), text.end());
+    buffer.push_back('\0');
+    buffer.push_back('\0');
+    return parseDocument(buffer);
+}
+
+TEST(ParseTest, RecoversFromSyntaxErrorsAndLocatesThem) {
+    std::vector<char> buffer;
+    parseResult result = parseSource(
+        "\\begin{document}\n"
+        "Intro.\n"
+        "\\begin{itemize}\n"
+        "  loose text\n"
+        "\\end{itemize}\n"
+        "\\section{$x$}\n"
+        "Some text.\n"
+        "More text } here.\n"
+        "\\begin{tabular}{|c|}\n"
+        "x & y \\\\\n"
+        "\\end{tabular}\n"
+        "\\section{Last}\n"
+        "Tail.\n"
+        "\\end{document}\n", buffer);
+
+    ASSERT_NE(result.tree, nullptr);
+    EXPECT_EQ(result.failure, "");
+    ASSERT_EQ(result.errors.size(), 4u);
+    EXPECT_EQ(result.errors[0].line, 4);  //! Text in a list before any \item; the list is skipped to its \end
+    EXPECT_EQ(result.errors[0].column, 1);
+    EXPECT_EQ(result.errors[0].message, "syntax error, unexpected STRING, expecting ITEM or BEGIN_ITEMIZE or BEGIN_ENUMERATE");
+    EXPECT_EQ(result.errors[1].line, 6);  //! Math in a heading title; the heading is kept without a title
+    EXPECT_EQ(result.errors[1].column, 10);
+    EXPECT_EQ(result.errors[2].line, 8);  //! A brace that closes nothing
+    EXPECT_EQ(result.errors[2].column, 11);
+    EXPECT_EQ(result.errors[2].message, "syntax error, unexpected END_CURLY");
+    EXPECT_EQ(result.errors[3].line, 10); //! A table row before the first \hline
+    EXPECT_EQ(result.errors[3].column, 1);
+
+    //! The parts of the document around the errors are converted as usual
+    converter c;
+    std::string markdown = c.convert(result.tree);
+    EXPECT_NE(markdown.find("Intro."), std::string::npos);
+    EXPECT_NE(markdown.find("Some text."), std::string::npos);
+    EXPECT_NE(markdown.find("## 2 Last"), std::string::npos);
+    EXPECT_NE(markdown.find("Tail."), std::string::npos);
+    delete result.tree;
+}
+
+TEST(ParseTest, SkipsAFigureThatDoesNotParse) {
+    std::vector<char> buffer;
+    parseResult result = parseSource(
+        "\\begin{document}\n"
+        "\\begin{figure}\n"
+        "loose text\n"
+        "\\end{figure}\n"
+        "\\begin{figure}\n"
+        "\\includegraphics[width=0.5]{a.png}\n"
+        "\\label{fig:a}\n"
+        "\\end{figure}\n"
+        "See \\ref{fig:a}.\n"
+        "\\end{document}\n", buffer);
+
+    ASSERT_NE(result.tree, nullptr);
+    ASSERT_EQ(result.errors.size(), 1u);
+    EXPECT_EQ(result.errors[0].line, 3);
+
+    converter c;
+    std::string markdown = c.convert(result.tree);
+    EXPECT_EQ(markdown.find("![]()"), std::string::npos);
+    EXPECT_NE(markdown.find("![](a.png)"), std::string::npos);
+    EXPECT_NE(markdown.find("[1](#fig:a)"), std::string::npos);
+
+    htmlEmitter html;
+    std::vector<emitter*> backends = {&html};
+    emitDocument(result.tree, backends);
+    EXPECT_EQ(html.output().find("<img src=\"\">"), std::string::npos);
+    EXPECT_NE(html.output().find("<a href=\"#fig:a\">1</a>"), std::string::npos);
+    delete result.tree;
+}
+
+TEST(ParseTest, LocatesErrorsAfterMultiLineMacrosInTheSource) {
+    std::string text =
+        "\\begin{document}\n"
+        "\\newcommand{\\x}{\nX\n}\n"
+        "\\x\n"
+        "More text } here.\n"
+        "\\end{document}\n";
+    std::vector<char> buffer(text.begin(), text.end());
+    buffer.push_back('\0');
+    buffer.push_back('\0');
+    std::vector<int> sourceLines;
+    ASSERT_TRUE(expandMacros(buffer, "test.tex", &sourceLines));
+    parseResult result = parseDocument(buffer, sourceLines);
+
+    ASSERT_NE(result.tree, nullptr);
+    ASSERT_EQ(result.errors.size(), 1u);
+    EXPECT_EQ(result.errors[0].line, 6);
+    EXPECT_EQ(result.errors[0].column, 11);
+    delete result.tree;
+}
+
+TEST(ParseTest, FailsWhenAnEnvironmentIsNeverClosed) {
+    std::vector<char> buffer;
+    parseResult result = parseSource("\\begin{document}\n\\begin{itemize}\n\\item One\n\\end{document}\n", buffer);
+
+    EXPECT_EQ(result.tree, nullptr);
+    EXPECT_EQ(result.failure, "could not recover from syntax errors");
+    ASSERT_EQ(result.errors.size(), 1u);
+    EXPECT_EQ(result.errors[0].line, 4);
+    EXPECT_EQ(result.errors[0].column, 1);
+}
+
+TEST(ParseTest, ClosesMathEnvironmentsOnlyWithTheirOwnEnd) {
+    std::vector<char> buffer;
+    parseResult result = parseSource("\\begin{document}\n\\begin{align}a \\end{equation} b\\end{align}\n\\end{document}\n", buffer);
+
+    ASSERT_NE(result.tree, nullptr);
+    EXPECT_TRUE(result.errors.empty());
+    converter c;
+    EXPECT_NE(c.convert(result.tree).find("a \\end{equation} b"), std::string::npos);
+    delete result.tree;
+
+    result = parseSource("\\begin{document}\nText.\n  \\begin{equation*} x = 1\n\\end{document}\n", buffer);
+    EXPECT_EQ(result.tree, nullptr);
+    ASSERT_FALSE(result.errors.empty());
+    EXPECT_EQ(result.errors[0].line, 3);
+    EXPECT_EQ(result.errors[0].column, 3);
+    EXPECT_EQ(result.errors[0].message, "unterminated equation* environment");
+}
+
+TEST(ParseTest, ReturnsToTheTableAfterAFigureInACell) {
+    std::vector<char> buffer;
+    parseResult result = parseSource(
+        "\\begin{document}\n"
+        "\\begin{tabular}{|c|}\n"
+        "\\hline\n"
+        "\\begin{figure}\\centering\\end{figure} \\\\\n"
+        "\\hline\n"
+        "\\end{tabular}\n"
+        "After the table.\n"
+        "\\end{document}\n", buffer);
+
+    // Cells hold text only, so the figure is an error, but the table still ends at its own \end{tabular}
+    ASSERT_NE(result.tree, nullptr);
+    ASSERT_EQ(result.errors.size(), 1u);
+    EXPECT_EQ(result.errors[0].line, 4);
+    EXPECT_EQ(result.errors[0].column, 1);
+    converter c;
+    EXPECT_NE(c.convert(result.tree).find("After the table."), std::string::npos);
+    delete result.tree;
+}
+
+TEST(ParseTest, ScansReferenceKeysVerbatim) {
+    std::vector<char> buffer;
+    parseResult result = parseSource(
+        "\\begin{document}\n"
+        "\\section{Intro}\\label{sec:intro_1}\n"
+        "See \\ref{sec:intro_1} and \\cite[p.~5]{smith_2020, jones}.\n"
+        "\\end{document}\n", buffer);
+
+    ASSERT_NE(result.tree, nullptr);
+    EXPECT_TRUE(result.errors.empty());
+    converter c;
+    std::string markdown = c.convert(result.tree);
+    EXPECT_NE(markdown.find("[1](#sec:intro_1)"), std::string::npos);
+    EXPECT_NE(markdown.find("[[1](#ref-smith_2020), [2](#ref-jones), p. 5]"), std::string::npos);
+    delete result.tree;
+}
+
+TEST(ParseTest, SplitSectionsWritesOtherFormatsFromTheSameWalk) {
+    std::vector<char> buffer;
+    parseResult result = parseSource(
+        "\\title{A \\& B}\n"
+        "\\begin{document}\n"
+        "See \\ref{sec:b} and \\ref{fig:x}.\n"
+        "\\section{Intro}\\label{sec:a}\n"
+        "Text with \\textbf{bold}, $x^2$ and \\cite[p.~5]{k1, k2}.\n"
+        "\\par More \\href{http://x.y}{link} here.\n"
+        "\\begin{itemize}\n\\item One\n\\item #two\n\\end{itemize}\n"
+        "\\begin{enumerate}\n\\item A\n\\item B\n\\end{enumerate}\n"
+        "\\subsection{Sub}\n"
+        "\\begin{tabular}{|c|c|}\n\\hline\na & b \\\\\nc & d* \\\\ \\hline\n\\end{tabular}\n"
+        "\\begin{figure}\n\\includegraphics[width=0.5]{img.png}\n\\caption{Cap}\n\\label{fig:x}\n\\end{figure}\n"
+        "$$\\sqrt{x+1}$$\n"
+        "\\begin{verbatim}\ncode\n\\end{verbatim}\n"
+        "\\section{B}\\label{sec:b}\n"
+        "Back to \\ref{sec:a}, \\ref{missing} and \\cite{k1}.\n"
+        "\\end{document}\n", buffer);
+    ASSERT_NE(result.tree, nullptr);
+    EXPECT_TRUE(result.errors.empty());
+
+    for (bool transform : {false, true}) {
+        converter single, split;
+        single.setMathTransform(transform);
+        split.setMathTransform(transform);
+        htmlEmitter html, alone;
+        jsonEmitter json;
+        std::vector<sectionChunk> chunks = split.splitSections(result.tree, {&html, &json});
+        emitDocument(result.tree, {&alone});
+        EXPECT_EQ(html.output(), alone.output());
+        EXPECT_FALSE(json.output().empty());
+
+        //! The chunks are cut at the top-level sections, with links through the files
+        std::string markdown = single.convert(result.tree);
+        ASSERT_EQ(chunks.size(), 3u);
+        EXPECT_NE(chunks[0].markdown.find("[2](02-b.md#sec:b) and [1](01-intro.md#fig:x)"), std::string::npos);
+        EXPECT_NE(chunks[1].markdown.find("[[1](index.md#ref-k1), [2](index.md#ref-k2), p. 5]"), std::string::npos);
+        EXPECT_NE(chunks[2].markdown.find("Back to [1](01-intro.md#sec:a)"), std::string::npos);
+        EXPECT_NE(markdown.find("Back to [1](#sec:a)"), std::string::npos);
+    }
+    delete result.tree;
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,183 @@
+#include "utf8.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//! Length of the leading run of ASCII bytes in `data`
+size_t asciiPrefix(const char* data, size_t len) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(block) != 0) break;  //! Some byte has its high bit set
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+        if (vmaxvq_u8(block) >= 0x80) break;
+    }
+#else
+    for (; i + 8 <= len; i += 8) {
+        uint64_t block;
+        memcpy(&block, data + i, 8);
+        if (block & 0x8080808080808080ULL) break;
+    }
+#endif
+    while (i < len && static_cast<unsigned char>(data[i]) < 0x80) i++;
+    return i;
+}
+
+//! Length of the well-formed multi-byte sequence at `p`, or 0 if it is invalid (Unicode Table 3-7)
+static size_t sequenceLength(const unsigned char* p, size_t avail) {
+    unsigned char lead = p[0];
+    size_t len;
+    unsigned char lo = 0x80, hi = 0xBF;  //! Allowed range of the second byte
+    if (lead >= 0xC2 && lead <= 0xDF) len = 2;
+    else if (lead >= 0xE0 && lead <= 0xEF) {
+        len = 3;
+        if (lead == 0xE0) lo = 0xA0;        //! Overlong
+        else if (lead == 0xED) hi = 0x9F;   //! Surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        len = 4;
+        if (lead == 0xF0) lo = 0x90;        //! Overlong
+        else if (lead == 0xF4) hi = 0x8F;   //! Above U+10FFFF
+    } else {
+        return 0;
+    }
+    if (avail < len || p[1] < lo || p[1] > hi) return 0;
+    for (size_t k = 2; k < len; k++) {
+        if ((p[k] & 0xC0) != 0x80) return 0;
+    }
+    return len;
+}
+
+//! Multi-byte text is validated this many bytes at a time before the scalar check takes over at an error
+const size_t RUN = 256;
+
+#if defined(__SSE2__)
+//! Bytes of `flipped` (the input XOR 0x80, so that unsigned order becomes signed order) that are at least `t`
+static inline __m128i atLeast(__m128i flipped, unsigned char t) {
+    return _mm_cmpgt_epi8(flipped, _mm_set1_epi8(static_cast<char>((t - 1) ^ 0x80)));
+}
+
+//! `current` shifted up `n` byte positions, with the top bytes of `previous` shifted in
+#define SHIFT_IN(current, previous, n) _mm_or_si128(_mm_slli_si128(current, n), _mm_srli_si128(previous, 16 - (n)))
+
+//! Validates text[0, len), which starts a sequence, 16 bytes at a time and returns the length of the prefix made of
+//! whole valid sequences, which stops before a sequence cut by the last block, or 0 if there is an invalid one.
+//! A byte must be a continuation exactly when one of the three bytes before it is a lead that reaches it; the lead
+//! masks of the block before are shifted in, so that the blocks are checked independently of each other.
+//! Sets `multiByte` if any byte is non-ASCII.
+static size_t validRun(const unsigned char* p, size_t len, bool& multiByte) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i error = zero, seen = zero, previous = zero, lead2 = zero, lead3 = zero, lead4 = zero;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i flipped = _mm_xor_si128(bytes, _mm_set1_epi8(static_cast<char>(0x80)));
+        __m128i is2 = atLeast(flipped, 0xC0), is3 = atLeast(flipped, 0xE0), is4 = atLeast(flipped, 0xF0);
+        __m128i continuation = _mm_andnot_si128(is2, atLeast(flipped, 0x80));
+        __m128i expected = _mm_or_si128(SHIFT_IN(is2, lead2, 1), _mm_or_si128(SHIFT_IN(is3, lead3, 2), SHIFT_IN(is4, lead4, 3)));
+        error = _mm_or_si128(error, _mm_xor_si128(expected, continuation));
+        //! Leads C0 and C1 are always overlong, F5-FF above U+10FFFF
+        error = _mm_or_si128(error, _mm_andnot_si128(atLeast(flipped, 0xC2), is2));
+        error = _mm_or_si128(error, atLeast(flipped, 0xF5));
+        //! Second bytes that make E0 and F0 overlong, ED a surrogate and F4 above U+10FFFF
+        __m128i before = SHIFT_IN(bytes, previous, 1);
+        __m128i second = atLeast(flipped, 0xA0), third = atLeast(flipped, 0x90);
+        error = _mm_or_si128(error, _mm_andnot_si128(second, _mm_cmpeq_epi8(before, _mm_set1_epi8(static_cast<char>(0xE0)))));
+        error = _mm_or_si128(error, _mm_and_si128(second, _mm_cmpeq_epi8(before, _mm_set1_epi8(static_cast<char>(0xED)))));
+        error = _mm_or_si128(error, _mm_andnot_si128(third, _mm_cmpeq_epi8(before, _mm_set1_epi8(static_cast<char>(0xF0)))));
+        error = _mm_or_si128(error, _mm_and_si128(third, _mm_cmpeq_epi8(before, _mm_set1_epi8(static_cast<char>(0xF4)))));
+        seen = _mm_or_si128(seen, bytes);
+        previous = bytes;
+        lead2 = is2;
+        lead3 = is3;
+        lead4 = is4;
+    }
+    multiByte = _mm_movemask_epi8(seen) != 0;
+    if (_mm_movemask_epi8(error) != 0) return 0;
+    //! At most one sequence is cut: a lead in the last byte, a 3- or 4-byte lead in the one before, or a 4-byte lead
+    //! in the one before that
+    if (_mm_movemask_epi8(lead2) & 0x8000) return i - 1;
+    if (_mm_movemask_epi8(lead3) & 0x4000) return i - 2;
+    if (_mm_movemask_epi8(lead4) & 0x2000) return i - 3;
+    return i;
+}
+#undef SHIFT_IN
+#elif defined(__ARM_NEON)
+//! `current` shifted up `n` byte positions, with the top bytes of `previous` shifted in
+#define SHIFT_IN(current, previous, n) vextq_u8(previous, current, 16 - (n))
+
+static size_t validRun(const unsigned char* p, size_t len, bool& multiByte) {
+    const uint8x16_t zero = vdupq_n_u8(0);
+    uint8x16_t error = zero, seen = zero, previous = zero, lead2 = zero, lead3 = zero, lead4 = zero;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t bytes = vld1q_u8(p + i);
+        uint8x16_t is2 = vcgeq_u8(bytes, vdupq_n_u8(0xC0));
+        uint8x16_t is3 = vcgeq_u8(bytes, vdupq_n_u8(0xE0));
+        uint8x16_t is4 = vcgeq_u8(bytes, vdupq_n_u8(0xF0));
+        uint8x16_t continuation = vbicq_u8(vcgeq_u8(bytes, vdupq_n_u8(0x80)), is2);
+        uint8x16_t expected = vorrq_u8(SHIFT_IN(is2, lead2, 1), vorrq_u8(SHIFT_IN(is3, lead3, 2), SHIFT_IN(is4, lead4, 3)));
+        error = vorrq_u8(error, veorq_u8(expected, continuation));
+        error = vorrq_u8(error, vbicq_u8(is2, vcgeq_u8(bytes, vdupq_n_u8(0xC2))));
+        error = vorrq_u8(error, vcgeq_u8(bytes, vdupq_n_u8(0xF5)));
+        uint8x16_t before = SHIFT_IN(bytes, previous, 1);
+        uint8x16_t second = vcgeq_u8(bytes, vdupq_n_u8(0xA0)), third = vcgeq_u8(bytes, vdupq_n_u8(0x90));
+        error = vorrq_u8(error, vbicq_u8(vceqq_u8(before, vdupq_n_u8(0xE0)), second));
+        error = vorrq_u8(error, vandq_u8(vceqq_u8(before, vdupq_n_u8(0xED)), second));
+        error = vorrq_u8(error, vbicq_u8(vceqq_u8(before, vdupq_n_u8(0xF0)), third));
+        error = vorrq_u8(error, vandq_u8(vceqq_u8(before, vdupq_n_u8(0xF4)), third));
+        seen = vorrq_u8(seen, bytes);
+        previous = bytes;
+        lead2 = is2;
+        lead3 = is3;
+        lead4 = is4;
+    }
+    multiByte = vmaxvq_u8(seen) >= 0x80;
+    if (vmaxvq_u8(error) != 0) return 0;
+    if (vgetq_lane_u8(lead2, 15)) return i - 1;
+    if (vgetq_lane_u8(lead3, 14)) return i - 2;
+    if (vgetq_lane_u8(lead4, 13)) return i - 3;
+    return i;
+}
+#undef SHIFT_IN
+#endif
+
+//! Validates `data` as UTF-8 and returns the byte offsets of invalid sequences
+std::vector<size_t> validateUtf8(const char* data, size_t len) {
+    std::vector<size_t> invalid;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+    while (i < len) {
+        i += asciiPrefix(data + i, len - i);
+        //! Consume the whole multi-byte run, and the ASCII bytes mixed into it, before going back to the ASCII fast path
+        bool multiByte = false;
+        while (i < len && (bytes[i] >= 0x80 || multiByte)) {
+            size_t end = len - i < RUN ? len : i + RUN;
+#if defined(__SSE2__) || defined(__ARM_NEON)
+            //! Valid text is checked a run at a time; a run with an error, or a short tail, is walked sequence by sequence
+            size_t valid = end - i >= 16 ? validRun(bytes + i, end - i, multiByte) : 0;
+            if (valid) {
+                i += valid;
+                continue;
+            }
+#endif
+            while (i < end) {
+                size_t n = bytes[i] < 0x80 ? 1 : sequenceLength(bytes + i, len - i);
+                if (n == 0) {
+                    invalid.push_back(i);
+                    n = 1;
+                }
+                i += n;
+            }
+        }
+    }
+    return invalid;
+}
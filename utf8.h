@@ -0,0 +1,16 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <cstddef>
+#include <vector>
+
+//! Length of the leading run of ASCII bytes in `data`; checks 16 bytes at a time with SSE2/NEON when available
+size_t asciiPrefix(const char* data, size_t len);
+
+//! Validates `data` as UTF-8 and returns the byte offsets of invalid sequences
+//! (stray continuation bytes, overlong forms, surrogates, code points above U+10FFFF, truncated sequences).
+//! ASCII runs are skipped with asciiPrefix; multi-byte text is checked 16 bytes at a time with SSE2/NEON, and only
+//! a stretch that holds an error is walked sequence by sequence.
+std::vector<size_t> validateUtf8(const char* data, size_t len);
+
+#endif //! UTF8_H